@@ -9,6 +9,9 @@
 #include <math.h>
 #include <numeric>
 #include <memory>
+#include <deque>
+#include <thread>
+#include <atomic>
 #include <Eigen/SparseLU>
 #include <Eigen/Dense>
 #include<Eigen/SparseCholesky>	
@@ -19,6 +22,10 @@
 //Make all stifness matrices only triangular stuff
 #include "raylib.h"
 #include <algorithm>
+#include "ordering.h"
+#include "iterative.h"
+#include "duplicates.h"
+#include "factorCache.h"
 
 //double error tolerance
 #define ERR_TOLERANCE 0.000000001
@@ -30,6 +37,32 @@
 
 namespace Beams {
 
+	//Splits [0,count) into one contiguous chunk per thread and runs func(begin,end) on each. noThreads = 0 uses all cores.
+	//Chunks only depend on count and the thread count, and func is expected to write to its own chunk only.
+	template <typename Func>
+	void parallelFor(size_t count, unsigned noThreads, Func func) {
+		if (noThreads == 0) noThreads = std::max(1u, std::thread::hardware_concurrency());
+		if (noThreads > count) noThreads = (unsigned)std::max<size_t>(1, count);
+
+		if (noThreads == 1) {
+			func((size_t)0, count);
+			return;
+		}
+
+		std::vector<std::thread> threads;
+		threads.reserve(noThreads - 1);
+		size_t chunk = count / noThreads;
+		size_t remainder = count % noThreads;
+		size_t begin = 0;
+		for (unsigned t = 0; t < noThreads; t++) {
+			size_t end = begin + chunk + (t < remainder);
+			if (t == noThreads - 1) func(begin, end); //last chunk on the calling thread
+			else threads.emplace_back(func, begin, end);
+			begin = end;
+		}
+		for (auto& thread : threads) thread.join();
+	}
+
 	struct Node {
 		double x, y, z;
 		double xRender;
@@ -41,7 +74,8 @@ namespace Beams {
 		int pos; //position of Coords in the points vector;
 
 		bool free_flag = true; //DOFs not used in stifness matrix
-		std::set<Eigen::Index> inElements;
+		unsigned elementEnds = 0; //elements using the node as end node, free_flag <=> 0. Which elements is in the Model's NodeAdjacency
+		Node() = default;
 		Node(double x_, double y_, double z_, size_t id_) {
 			x = x_;
 			y = y_;
@@ -68,30 +102,22 @@ namespace Beams {
 		return false;
 	}
 
-	//UNUSED -> maybe for map with common local stiffness matrices mapped to element length. 
-	class Length {
-		double l;
-
-		bool operator< (const Length& v) {
-			if (std::abs(l - v.l) > ERR_TOLERANCE) return l < v.l;
-			return false;
-		}
-	};
-
 
+	//Nodes stay at their position (the position is their id for elements, forces & BCs). Deleted slots are tombstones that
+	//are reused by later insertions through an intrusive free list, until compact() drops them.
 	class NodeContainer {
-		std::vector<Node> Nodes;
-		std::set<size_t> deleted;
+		static const size_t NO_SLOT = SIZE_MAX;
 
-
-		Node& get_NotDeleted(size_t pos) {
-			auto it = deleted.find(pos);
-			auto endIt = deleted.end();
-			while (it != endIt) {
-				pos++;
-				it = deleted.find(pos);
-			}
-			return Nodes[pos];
+		std::vector<Node> Nodes;
+		std::vector<uint64_t> deletedBits; //tombstone bitmap, one bit per slot
+		std::vector<size_t> live; //positions of the not deleted nodes. Removal moves the last one into the gap, so it is not sorted
+		std::vector<size_t> liveIndex; //slot -> index in live, for live slots
+		size_t freeHead = NO_SLOT; //deleted slots chain through their matrixPos, most recently deleted first
+
+		void setDeletedBit(size_t pos, bool deleted) {
+			uint64_t bit = uint64_t(1) << (pos & 63);
+			if (deleted) deletedBits[pos >> 6] |= bit;
+			else deletedBits[pos >> 6] &= ~bit;
 		}
 
 	public:
@@ -104,89 +130,126 @@ namespace Beams {
 			using pointer =  const Node*;
 			using reference =  const Node&;
 
-			explicit notDeleted_const_iterator(const std::vector<Node>& nodes, const std::set<size_t>& deleted, size_t pos) : m_nodes(nodes), m_deleted(deleted), m_pos(pos) {}
+			explicit notDeleted_const_iterator(const std::vector<Node>& nodes, const size_t* livePos) : m_nodes(nodes), m_livePos(livePos) {}
 
-			reference operator*() const { return m_nodes[m_pos]; }
-			//pointer operator->() { return m_ptr; }
+			reference operator*() const { return m_nodes[*m_livePos]; }
+			pointer operator->() const { return &m_nodes[*m_livePos]; }
 			notDeleted_const_iterator& operator++() { 
-				//m_ptr++; 
-				m_pos++;
-				while (m_deleted.find(m_pos) != m_deleted.end()) {
-					m_pos++;
-					//m_ptr++;
-				}
-				
+				m_livePos++;
 				return *this; 
 			}
 			notDeleted_const_iterator operator++(int) { notDeleted_const_iterator tmp = *this; ++(*this); return tmp; }
-			friend bool operator== (const notDeleted_const_iterator& a, const notDeleted_const_iterator& b) { return a.m_pos == b.m_pos; };
-			friend bool operator!= (const notDeleted_const_iterator& a, const notDeleted_const_iterator& b) { return a.m_pos != b.m_pos; };
+			friend bool operator== (const notDeleted_const_iterator& a, const notDeleted_const_iterator& b) { return a.m_livePos == b.m_livePos; };
+			friend bool operator!= (const notDeleted_const_iterator& a, const notDeleted_const_iterator& b) { return a.m_livePos != b.m_livePos; };
 		private:	
-			//pointer m_ptr;
 			const std::vector<Node>& m_nodes;
-			const std::set<size_t>& m_deleted;
-			size_t m_pos;
+			const size_t* m_livePos;
 		};
 		
 		notDeleted_const_iterator begin() const {  
-
-			return notDeleted_const_iterator(Nodes, deleted, 0+(!size() * Nodes.size())); 
+			return notDeleted_const_iterator(Nodes, live.data());
+		}
+		notDeleted_const_iterator end() const { return notDeleted_const_iterator(Nodes, live.data() + live.size()); }
+
+		//capacity for noMore additional nodes
+		void reserve(size_t noMore) {
+			Nodes.reserve(Nodes.size() + noMore);
+			live.reserve(live.size() + noMore);
+			liveIndex.reserve(liveIndex.size() + noMore);
+			deletedBits.reserve((Nodes.size() + noMore) / 64 + 1);
 		}
-		notDeleted_const_iterator end() const { return notDeleted_const_iterator(Nodes, deleted, Nodes.size()); }
 
 		void emplace(Vector3& point) {
-			if (deleted.size() > 0) {
-				auto firstIt = deleted.begin();
-				size_t pos = *firstIt;
-				Nodes[pos].x = point.x;
-				Nodes[pos].y = point.y;
-				Nodes[pos].z = point.z;
-				Nodes[pos].xRender = point.x*RENDER_SCALING_FACTOR;
-				Nodes[pos].yRender = point.y*RENDER_SCALING_FACTOR;
-				Nodes[pos].zRender = point.z*RENDER_SCALING_FACTOR;
-
-				Nodes[pos].matrixPos = -1;
-				Nodes[pos].free_flag= true; //extra safety
-
-				deleted.erase(firstIt);
+			emplace(point.x, point.y, point.z);
+		}
+
+		void emplace(double x, double y, double z) {
+			if (freeHead != NO_SLOT) {
+				size_t pos = freeHead;
+				Node& node = Nodes[pos];
+				freeHead = node.matrixPos;
+				node.x = x;
+				node.y = y;
+				node.z = z;
+				node.xRender = x*RENDER_SCALING_FACTOR;
+				node.yRender = y*RENDER_SCALING_FACTOR;
+				node.zRender = z*RENDER_SCALING_FACTOR;
+
+				node.matrixPos = -1;
+				node.free_flag= true; //extra safety
+				node.elementEnds = 0;
+
+				setDeletedBit(pos, false);
+				liveIndex[pos] = live.size();
+				live.push_back(pos);
 				return;
 			}
 
-			Nodes.emplace_back(point.x, point.y, point.z, -1);
+			Nodes.emplace_back(x, y, z, -1);
 			Nodes.back().pos = Nodes.size() - 1;
+			if (deletedBits.size() * 64 < Nodes.size()) deletedBits.push_back(0);
+			liveIndex.push_back(live.size());
+			live.push_back(Nodes.size() - 1);
+		}
+
+		//count nodes after the last slot, filled on noThreads. Deleted slots are not reused.
+		void append(size_t count, const double* x, const double* y, const double* z, unsigned noThreads) {
+			size_t first = Nodes.size(), firstLive = live.size();
+			Nodes.resize(first + count);
+			live.resize(firstLive + count);
+			liveIndex.resize(first + count);
+			deletedBits.resize((first + count + 63) / 64, 0);
+			parallelFor(count, noThreads, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++) {
+					Node& node = Nodes[first + i];
+					node = Node(x[i], y[i], z[i], -1);
+					node.pos = (int)(first + i);
+					live[firstLive + i] = first + i;
+					liveIndex[first + i] = firstLive + i;
+				}
+			});
+		}
 
+		void remove(size_t pos) {
+			if (isDeleted(pos)) return;
+			setDeletedBit(pos, true);
 
-			return;
+			size_t index = liveIndex[pos];
+			live[index] = live.back();
+			liveIndex[live[index]] = index;
+			live.pop_back();
 
+			Nodes[pos].matrixPos = freeHead;
+			freeHead = pos;
 		}
 
-		void remove(size_t pos) {
-			if (pos >= Nodes.size()) return;
-			deleted.insert(pos);
-			return;
+		//positions past the last slot count as deleted, there is no node there
+		bool isDeleted(size_t pos) const {
+			if (pos >= Nodes.size()) return true;
+			return (deletedBits[pos >> 6] >> (pos & 63)) & 1;
 		}
 
 		//Gets non deleted size
 		size_t  size() const {
-			return Nodes.size() - deleted.size();
+			return live.size();
+		}
+
+		//Slots including deleted ones. Positions are < slotCount()
+		size_t slotCount() const {
+			return Nodes.size();
 		}
 
 		void clear() {
 			Nodes.clear();
-			deleted.clear();
+			deletedBits.clear();
+			live.clear();
+			liveIndex.clear();
+			freeHead = NO_SLOT;
 		}
 
-		//Returns nth not deleted node. For iterations
+		//Returns nth not deleted node, in iteration order. For iterations
 		const Node& get_notDeleted(size_t pos) const {
-			auto endIt = deleted.end();
-			
-			size_t undeleted = (deleted.begin() == deleted.end()) ? 0 :  *deleted.begin();
-			for (size_t i = undeleted; i <= pos; i++) {
-				if (deleted.find(i) != deleted.end()) pos++;
-			}
-
-			return Nodes[pos];
-
+			return Nodes[live[pos]];
 		}
 
 		//Returns Node despite if its deleted or not. For Elements
@@ -194,6 +257,27 @@ namespace Beams {
 			return Nodes[pos];
 		}
 
+		//Drops the deleted slots, live nodes keep their relative order. Returns old position -> new position, NO_SLOT for deleted ones.
+		std::vector<size_t> compact() {
+			std::vector<size_t> remap(Nodes.size(), NO_SLOT);
+			size_t next = 0;
+			for (size_t pos = 0; pos < Nodes.size(); pos++) {
+				if (isDeleted(pos)) continue;
+				remap[pos] = next;
+				if (next != pos) Nodes[next] = std::move(Nodes[pos]);
+				Nodes[next].pos = (int)next;
+				next++;
+			}
+			Nodes.erase(Nodes.begin() + next, Nodes.end());
+
+			deletedBits.assign((next + 63) / 64, 0);
+			live.resize(next);
+			std::iota(live.begin(), live.end(), 0);
+			liveIndex = live;
+			freeHead = NO_SLOT;
+			return remap;
+		}
+
 		void setFree_byPos(size_t pos, bool free) {
 			Nodes[pos].free_flag = free;
 			return;
@@ -203,16 +287,16 @@ namespace Beams {
 			return Nodes[pos].free_flag;
 		}
 
-		void add_InElement_byPos(size_t pos, Eigen::Index id) {
+		void addElementEnd_byPos(size_t pos) {
 			Node& node = Nodes[pos];
-			node.inElements.insert(id);
-			//free gets set from outside here. 
+			node.elementEnds++;
+			node.free_flag = false;
 		}
 
-		void remove_InElement_byPos(size_t pos, Eigen::Index id) {
+		void removeElementEnd_byPos(size_t pos) {
 			Node& node = Nodes[pos];
-			node.inElements.erase(id);
-			node.free_flag = !node.inElements.size();
+			if (node.elementEnds > 0) node.elementEnds--;
+			node.free_flag = !node.elementEnds;
 		}
 
 		void setMatrixPos_byPos(size_t pos, Eigen::Index matPos) {
@@ -220,13 +304,13 @@ namespace Beams {
 		}
 
 		size_t get_nextInsertionPos() {
-			return (deleted.size() > 0) ? *deleted.begin() : Nodes.size();
+			return (freeHead != NO_SLOT) ? freeHead : Nodes.size();
 		}
 	};
 
 	class Section {
 	public:
-		std::vector<size_t> inElements;
+		std::vector<size_t> inElements; //positions in Model::Elements, ascending. Kept in step by addElement/removeElements
 		double Area;
 		double Ixx;
 		double Izz;
@@ -283,11 +367,205 @@ namespace Beams {
 		}
 	};
 
+	typedef Eigen::Matrix<double, 12, 12> Matrix12d;
+
+	//Local beam stiffness from its length scaled coefficients. Only the non-zero pattern is written, K has to be zeroed once before.
+	static inline void fillLocalStiffness(Matrix12d& K, double k1, double k2, double EIz12, double EIy12, double EIz6, double EIy6, double EIz4, double EIy4, double EIz2, double EIy2) {
+		K(0, 0) = k1;		K(0, 6) = -k1;
+		K(1, 1) = EIz12;	K(1, 5) = EIz6;		K(1, 7) = -EIz12;	K(1, 11) = EIz6;
+		K(2, 2) = EIy12;	K(2, 4) = -EIy6;	K(2, 8) = -EIy12;	K(2, 10) = -EIy6;
+		K(3, 3) = k2;		K(3, 9) = -k2;
+		K(4, 2) = -EIy6;	K(4, 4) = EIy4;		K(4, 8) = EIy6;		K(4, 10) = EIy2;
+		K(5, 1) = EIz6;		K(5, 5) = EIz4;		K(5, 7) = -EIz6;	K(5, 11) = EIz2;
+		K(6, 0) = -k1;		K(6, 6) = k1;
+		K(7, 1) = -EIz12;	K(7, 5) = -EIz6;	K(7, 7) = EIz12;	K(7, 11) = -EIz6;
+		K(8, 2) = -EIy12;	K(8, 4) = EIy6;		K(8, 8) = EIy12;	K(8, 10) = EIy6;
+		K(9, 3) = -k2;		K(9, 9) = k2;
+		K(10, 2) = -EIy6;	K(10, 4) = EIy2;	K(10, 8) = EIy6;	K(10, 10) = EIy4;
+		K(11, 1) = EIz6;	K(11, 5) = EIz2;	K(11, 7) = -EIz6;	K(11, 11) = EIz4;
+	}
+
+	//Global stiffness R*K*R^T. R is block diagonal with 4 copies of the direction cosines, so every 3x3 block (i,j) is just R*K_ij*R^T.
+	//K is symmetric, so only the upper blocks are calculated and the lower ones are their transposes.
+	static inline void rotateToGlobal(const Eigen::Matrix3d& R, const Matrix12d& local, Matrix12d& globalB) {
+		for (int bj = 0; bj < 4; ++bj) {
+			for (int bi = 0; bi <= bj; ++bi) {
+				Eigen::Matrix3d block = R * local.block<3, 3>(3 * bi, 3 * bj) * R.transpose();
+				globalB.block<3, 3>(3 * bi, 3 * bj) = block;
+				if (bi != bj) globalB.block<3, 3>(3 * bj, 3 * bi) = block.transpose();
+			}
+		}
+	}
+
+	//Local stiffness of a beam of the given section and length. Only the non-zero pattern is written, K has to be zeroed once before.
+	static inline void calcLocalStiffness(Matrix12d& K, const Section& section, double Len) {
+		double Area = section.Area;
+		double Modulus = section.Modulus;
+
+		double Lsq = 1 / std::pow(Len, 2);
+		double Lcb = 1 / std::pow(Len, 3);
+		double invLen = 1 / Len;
+		double EIz12 = section.EIz12 * Lcb;
+		double EIy12 = section.EIy12 * Lcb;
+		double EIz6 = section.EIz6 * Lsq;
+		double EIy6 = section.EIy6 * Lsq;
+		double EIz4 = section.EIz4 * invLen;
+		double EIy4 = section.EIy4 * invLen;
+		double EIz2 = section.EIz2 * invLen;
+		double EIy2 = section.EIy2 * invLen;
+
+		//Possible overflow issues with above? Further testing
+		/*double EIz12 = 12 * Modulus * Izz / pow(Len, 3);
+		double EIy12 = 12 * Modulus * Iyy / pow(Len, 3);
+		double EIz6 = 6 * Modulus * Izz / pow(Len, 2);
+		double EIy6 = 6 * Modulus * Iyy / pow(Len, 2);
+		double EIz4 = 4 * Modulus * Izz / pow(Len ,1);
+		double EIy4 = 4 * Modulus * Iyy / pow(Len ,1);
+		double EIz2 = 2 * Modulus * Izz / pow(Len ,1);
+		double EIy2 = 2 * Modulus * Iyy / pow(Len ,1);*/
+
+		double k1 = Modulus * Area / Len;
+		double k2 = section.Ixx * section.G / Len;// FIX THIS THIS IS WRONG <--------------------------------------------------
+		fillLocalStiffness(K, k1, k2, EIz12, EIy12, EIz6, EIy6, EIz4, EIy4, EIz2, EIy2);
+#ifdef DEBUG_PRINTS
+		static bool printed = false;
+		if (printed)return;
+		std::cout << "\n-------------------------------------------------------------------------------\n Local B Matrix\n" << K << "\n";
+		printed = true;
+#endif
+	}
+
+	struct StiffnessCacheStats {
+		size_t entries = 0; //distinct local matrices
+		size_t lookups = 0; //element creations and geometry updates
+		size_t hits = 0;    //lookups that found an existing matrix
+		size_t dropped = 0; //entries no element used any more, removed by compact
+
+		double hitRate() const {
+			return lookups ? (double)hits / lookups : 0.;
+		}
+	};
+
+	//Local stiffness matrices shared by all elements with the same section and length. Lengths are quantized to ERR_TOLERANCE,
+	//the tolerance nodes are merged with. Regular frames (grid bays, truss panels, copied storeys) need only a handful of matrices.
+	//Entries live in a deque, so the references handed out stay valid until compact() or clear().
+	class LocalStiffnessCache {
+		struct Key {
+			size_t sectionId;
+			int64_t length;
+
+			bool operator==(const Key& other) const {
+				return sectionId == other.sectionId && length == other.length;
+			}
+		};
+
+		struct KeyHash {
+			size_t operator()(const Key& key) const {
+				return (size_t)Duplicates::mix((uint64_t)key.sectionId * 0x9E3779B97F4A7C15ull ^ (uint64_t)key.length);
+			}
+		};
+
+		struct Entry {
+			Matrix12d K;
+			double length; //of the element that created the entry
+			Key key;
+		};
+
+		std::deque<Entry> entries;
+		std::unordered_map<Key, size_t, KeyHash> index;
+		std::map<size_t, std::vector<size_t>> entriesOfSection;
+		StiffnessCacheStats stats;
+
+	public:
+		const Matrix12d& get(size_t sectionId, const Section& section, double length) {
+			stats.lookups++;
+			Key key{ sectionId, std::llround(length / ERR_TOLERANCE) };
+			auto found = index.find(key);
+			if (found != index.end()) {
+				stats.hits++;
+				return entries[found->second].K;
+			}
+
+			index.emplace(key, entries.size());
+			entriesOfSection[sectionId].push_back(entries.size());
+			entries.emplace_back();
+			Entry& entry = entries.back();
+			entry.length = length;
+			entry.key = key;
+			entry.K.setZero();
+			calcLocalStiffness(entry.K, section, length);
+			stats.entries = entries.size();
+			return entry.K;
+		}
+
+		//Section properties changed: its matrices are rebuilt in place, so every element of the section sees the new values
+		void updateSection(size_t sectionId, const Section& section, unsigned noThreads) {
+			auto found = entriesOfSection.find(sectionId);
+			if (found == entriesOfSection.end()) return;
+			const std::vector<size_t>& sectionEntries = found->second;
+			//small sections are not worth the thread start up, sizing loops edit many of them
+			if (sectionEntries.size() < 4096) noThreads = 1;
+			parallelFor(sectionEntries.size(), noThreads, [&](size_t begin, size_t end) {
+				for (size_t k = begin; k < end; k++) {
+					Entry& entry = entries[sectionEntries[k]];
+					calcLocalStiffness(entry.K, section, entry.length);
+				}
+			});
+		}
+
+		//Drops the entries no element uses after elements were removed or moved. matrices: the matrix of every live element (repeats
+		//are fine), each is pointed at its kept entry. Matrices not owned by the cache are left alone. Every other reference into
+		//the cache is invalid afterwards.
+		void compact(std::vector<const Matrix12d*>& matrices) {
+			std::unordered_map<const Matrix12d*, size_t> entryOf;
+			entryOf.reserve(entries.size());
+			for (size_t i = 0; i < entries.size(); i++) entryOf.emplace(&entries[i].K, i);
+			std::vector<size_t> entryOfMatrix(matrices.size(), SIZE_MAX);
+			std::vector<char> used(entries.size(), 0);
+			for (size_t k = 0; k < matrices.size(); k++) {
+				auto found = entryOf.find(matrices[k]);
+				if (found == entryOf.end()) continue;
+				entryOfMatrix[k] = found->second;
+				used[found->second] = 1;
+			}
+
+			//kept entries stay in their order, so the section lists stay ascending
+			std::deque<Entry> kept;
+			std::vector<size_t> remap(entries.size(), SIZE_MAX);
+			index.clear();
+			entriesOfSection.clear();
+			for (size_t i = 0; i < entries.size(); i++) {
+				if (!used[i]) continue;
+				remap[i] = kept.size();
+				index.emplace(entries[i].key, kept.size());
+				entriesOfSection[entries[i].key.sectionId].push_back(kept.size());
+				kept.push_back(entries[i]);
+			}
+			for (size_t k = 0; k < matrices.size(); k++) {
+				if (entryOfMatrix[k] != SIZE_MAX) matrices[k] = &kept[remap[entryOfMatrix[k]]].K;
+			}
+			stats.dropped += entries.size() - kept.size();
+			entries.swap(kept);
+			stats.entries = entries.size();
+		}
+
+		const StiffnessCacheStats& getStats() const {
+			return stats;
+		}
+
+		void clear() {
+			entries.clear();
+			index.clear();
+			entriesOfSection.clear();
+			stats = StiffnessCacheStats();
+		}
+	};
+
 	class vBeam {
 		Eigen::Index id;
 
-		Eigen::SparseMatrix<double> localStiffnessMatrix;
-		Eigen::SparseMatrix<double> rotMatrix; //Cosine Matrix
+		const Matrix12d* localStiffnessMatrix; //shared, owned by the LocalStiffnessCache
+		Eigen::Matrix3d dirCosines; //Cosine Matrix block. The 12x12 rotation is 4 copies of it on the diagonal
 
 
 		double Len;
@@ -297,165 +575,8 @@ namespace Beams {
 		std::array<Eigen::Vector3d,3> localUnitVectors;
 
 
-		void calc_BMatrixTEST() {
-			double Area = 100;
-			double Izz = 100;
-			double Iyy = 100;
-			double Modulus = 210000;
-			double Lsq = Len * Len;
-			double sixLen = 6 * Len;
-			double EIz12 = 12 * Modulus * Izz / pow(Len, 3);
-			double EIy12 = 12 * Modulus * Iyy / pow(Len, 3);
-			double EIz6 = 6 * Modulus * Izz / pow(Len, 2);
-			double EIy6 = 6 * Modulus * Iyy / pow(Len, 2);
-			double EIz4 = 4 * Modulus * Izz / Len;
-			double EIy4 = 4 * Modulus * Iyy / Len;
-			double EIz2 = 2 * Modulus * Izz / Len;
-			double EIy2 = 2 * Modulus * Iyy / Len;
-			std::vector<Eigen::Triplet<double>> locStiffness_triplets(47);
-
-
-
-
-			double k1 = Modulus * Area / Len;
-			double k2 = Modulus * Area / Len;// FIX THIS THIS IS WRONG <--------------------------------------------------
-			locStiffness_triplets.emplace_back(0, 0, k1);
-			locStiffness_triplets.emplace_back(0, 6, -k1);
-			locStiffness_triplets.emplace_back(1, 1, EIz12);
-			locStiffness_triplets.emplace_back(1, 5, EIz6);
-			locStiffness_triplets.emplace_back(1, 7, -EIz12);
-			locStiffness_triplets.emplace_back(1, 11, EIz6);
-			locStiffness_triplets.emplace_back(2, 2, EIy12);
-			locStiffness_triplets.emplace_back(2, 4, -EIy6);
-			locStiffness_triplets.emplace_back(2, 8, -EIy12);
-			locStiffness_triplets.emplace_back(2, 10, -EIy6);
-			locStiffness_triplets.emplace_back(3, 3, k2);
-			locStiffness_triplets.emplace_back(3, 9, -k2);
-			locStiffness_triplets.emplace_back(4, 2, -EIy6);
-			locStiffness_triplets.emplace_back(4, 4, EIy4);
-			locStiffness_triplets.emplace_back(4, 8, EIy6);
-			locStiffness_triplets.emplace_back(4, 10, EIy2);
-			locStiffness_triplets.emplace_back(5, 1, EIz6);
-			locStiffness_triplets.emplace_back(5, 5, EIz4);
-			locStiffness_triplets.emplace_back(5, 7, -EIz6);
-			locStiffness_triplets.emplace_back(5, 11, EIz2);
-			locStiffness_triplets.emplace_back(6, 0, -k1);
-			locStiffness_triplets.emplace_back(6, 6, k1);
-			locStiffness_triplets.emplace_back(7, 1, -EIz12);
-			locStiffness_triplets.emplace_back(7, 5, -EIz6);
-			locStiffness_triplets.emplace_back(7, 7, EIz12);
-			locStiffness_triplets.emplace_back(7, 11, -EIz6);
-			locStiffness_triplets.emplace_back(8, 2, -EIy12);
-			locStiffness_triplets.emplace_back(8, 4, EIy6);
-			locStiffness_triplets.emplace_back(8, 8, EIy12);
-			locStiffness_triplets.emplace_back(8, 10, EIy6);
-			locStiffness_triplets.emplace_back(9, 3, -k2);
-			locStiffness_triplets.emplace_back(9, 9, k2);
-			locStiffness_triplets.emplace_back(10, 2, -EIy6);
-			locStiffness_triplets.emplace_back(10, 4, EIy2);
-			locStiffness_triplets.emplace_back(10, 8, EIy6);
-			locStiffness_triplets.emplace_back(10, 10, EIy4);
-			locStiffness_triplets.emplace_back(11, 1, EIz6);
-			locStiffness_triplets.emplace_back(11, 5, EIz2);
-			locStiffness_triplets.emplace_back(11, 7, -EIz6);
-			locStiffness_triplets.emplace_back(11, 11, EIz4);
-
-			localStiffnessMatrix.setFromTriplets(locStiffness_triplets.begin(), locStiffness_triplets.end());
-
-		};
-
 		void calc_Len(const Node& N2, const Node& N1) {
-			Len = std::pow((N2.x - N1.x), 2) + std::pow((N2.y - N1.y), 2) + std::pow((N2.z - N1.z), 2);
-			Len = std::sqrt(Len);
-		};
-
-		void calc_BMatrix(const Section section) {
-			localStiffnessMatrix.data().clear();
-			double Area = section.Area;
-			double Izz = section.Izz;
-			double Iyy = section.Iyy;
-			double Modulus = section.Modulus;
-
-			double Lsq = 1 / std::pow(Len, 2);
-			double Lcb = 1 / std::pow(Len, 3);
-			double invLen = 1 / Len;
-			double EIz12 = section.EIz12 * Lcb;
-			double EIy12 = section.EIy12 * Lcb;
-			double EIz6 = section.EIz6 * Lsq;
-			double EIy6 = section.EIy6 * Lsq;
-			double EIz4 = section.EIz4 * invLen;
-			double EIy4 = section.EIy4 * invLen;
-			double EIz2 = section.EIz2 * invLen;
-			double EIy2 = section.EIy2 * invLen;
-
-			//Possible overflow issues with above? Further testing
-			/*double EIz12 = 12 * Modulus * Izz / pow(Len, 3);
-			double EIy12 = 12 * Modulus * Iyy / pow(Len, 3);
-			double EIz6 = 6 * Modulus * Izz / pow(Len, 2);
-			double EIy6 = 6 * Modulus * Iyy / pow(Len, 2);
-			double EIz4 = 4 * Modulus * Izz / pow(Len ,1);
-			double EIy4 = 4 * Modulus * Iyy / pow(Len ,1);
-			double EIz2 = 2 * Modulus * Izz / pow(Len ,1);
-			double EIy2 = 2 * Modulus * Iyy / pow(Len ,1);*/
-
-
-
-
-			std::vector<Eigen::Triplet<double>> locStiffness_triplets;
-
-
-
-
-			double k1 = Modulus * Area / Len;
-			double k2 = section.Ixx * section.G / Len;// FIX THIS THIS IS WRONG <--------------------------------------------------
-			locStiffness_triplets.emplace_back(0, 0, k1);
-			locStiffness_triplets.emplace_back(0, 6, -k1);
-			locStiffness_triplets.emplace_back(1, 1, EIz12);
-			locStiffness_triplets.emplace_back(1, 5, EIz6);
-			locStiffness_triplets.emplace_back(1, 7, -EIz12);
-			locStiffness_triplets.emplace_back(1, 11, EIz6);
-			locStiffness_triplets.emplace_back(2, 2, EIy12);
-			locStiffness_triplets.emplace_back(2, 4, -EIy6);
-			locStiffness_triplets.emplace_back(2, 8, -EIy12);
-			locStiffness_triplets.emplace_back(2, 10, -EIy6);
-			locStiffness_triplets.emplace_back(3, 3, k2);
-			locStiffness_triplets.emplace_back(3, 9, -k2);
-			locStiffness_triplets.emplace_back(4, 2, -EIy6);
-			locStiffness_triplets.emplace_back(4, 4, EIy4);
-			locStiffness_triplets.emplace_back(4, 8, EIy6);
-			locStiffness_triplets.emplace_back(4, 10, EIy2);
-			locStiffness_triplets.emplace_back(5, 1, EIz6);
-			locStiffness_triplets.emplace_back(5, 5, EIz4);
-			locStiffness_triplets.emplace_back(5, 7, -EIz6);
-			locStiffness_triplets.emplace_back(5, 11, EIz2);
-			locStiffness_triplets.emplace_back(6, 0, -k1);
-			locStiffness_triplets.emplace_back(6, 6, k1);
-			locStiffness_triplets.emplace_back(7, 1, -EIz12);
-			locStiffness_triplets.emplace_back(7, 5, -EIz6);
-			locStiffness_triplets.emplace_back(7, 7, EIz12);
-			locStiffness_triplets.emplace_back(7, 11, -EIz6);
-			locStiffness_triplets.emplace_back(8, 2, -EIy12);
-			locStiffness_triplets.emplace_back(8, 4, EIy6);
-			locStiffness_triplets.emplace_back(8, 8, EIy12);
-			locStiffness_triplets.emplace_back(8, 10, EIy6);
-			locStiffness_triplets.emplace_back(9, 3, -k2);
-			locStiffness_triplets.emplace_back(9, 9, k2);
-			locStiffness_triplets.emplace_back(10, 2, -EIy6);
-			locStiffness_triplets.emplace_back(10, 4, EIy2);
-			locStiffness_triplets.emplace_back(10, 8, EIy6);
-			locStiffness_triplets.emplace_back(10, 10, EIy4);
-			locStiffness_triplets.emplace_back(11, 1, EIz6);
-			locStiffness_triplets.emplace_back(11, 5, EIz2);
-			locStiffness_triplets.emplace_back(11, 7, -EIz6);
-			locStiffness_triplets.emplace_back(11, 11, EIz4);
-
-			localStiffnessMatrix.setFromTriplets(locStiffness_triplets.begin(), locStiffness_triplets.end());
-#ifdef DEBUG_PRINTS
-			static bool printed = false;
-			if (printed)return;
-			std::cout << "\n-------------------------------------------------------------------------------\n Local B Matrix\n" << Eigen::MatrixXd(localBmatrix) << "\n";
-			printed = true;
-#endif
+			Len = lengthBetween(N1, N2);
 		};
 
 		void calc_LocalUnitVectors(const Node& N1, const Node& N2, const Node& N3) {
@@ -485,47 +606,36 @@ namespace Beams {
 		}
 
 		void calc_rotMatrix() {
-			static const Eigen::Vector3d xAxis(1, 0, 0);
-			static const Eigen::Vector3d yAxis(0, 1, 0);
-			static const Eigen::Vector3d zAxis(0, 0, 1);
-
-
-			Eigen::Vector3d localX_unit = localUnitVectors[0];
-			Eigen::Vector3d localY_unit = localUnitVectors[1];
-			Eigen::Vector3d localZ_unit = localUnitVectors[2];
-
-
-			std::vector<Eigen::Triplet<double>> dirCosineMat_triplets(37);
-
-
-			for (size_t i = 0; i < 12; i += 3) {
-				dirCosineMat_triplets.emplace_back(0 + i, 0 + i, localX_unit.adjoint() * xAxis);
-				dirCosineMat_triplets.emplace_back(0 + i, 1 + i, localY_unit.adjoint() * xAxis);
-				dirCosineMat_triplets.emplace_back(0 + i, 2 + i, localZ_unit.adjoint() * xAxis);
-
-				dirCosineMat_triplets.emplace_back(1 + i, 0 + i, localX_unit.adjoint() * yAxis);
-				dirCosineMat_triplets.emplace_back(1 + i, 1 + i, localY_unit.adjoint() * yAxis);
-				dirCosineMat_triplets.emplace_back(1 + i, 2 + i, localZ_unit.adjoint() * yAxis);
-
-				dirCosineMat_triplets.emplace_back(2 + i, 0 + i, localX_unit.adjoint() * zAxis);
-				dirCosineMat_triplets.emplace_back(2 + i, 1 + i, localY_unit.adjoint() * zAxis);
-				dirCosineMat_triplets.emplace_back(2 + i, 2 + i, localZ_unit.adjoint() * zAxis);
-			}
-
-			
-			rotMatrix.data().clear();
-
-
-			rotMatrix.setFromTriplets(dirCosineMat_triplets.begin(), dirCosineMat_triplets.end());
+			//Entry (r,c) is the cosine between global axis r and local axis c, so the columns are the local unit vectors.
+			dirCosines.col(0) = localUnitVectors[0];
+			dirCosines.col(1) = localUnitVectors[1];
+			dirCosines.col(2) = localUnitVectors[2];
 		}
 	public:
 
 		size_t node1Pos, node2Pos, node3Pos;
 
+		static double lengthBetween(const Node& N1, const Node& N2) {
+			return std::sqrt(std::pow((N2.x - N1.x), 2) + std::pow((N2.y - N1.y), 2) + std::pow((N2.z - N1.z), 2));
+		}
+
+		//Placeholder for storage that is filled in parallel, see Model::commit
+		vBeam() : id(-1), localStiffnessMatrix(nullptr), Len(0), sectionId(0), node1Pos(0), node2Pos(0), node3Pos(0) {}
+
+		//localStiffness: the cached matrix of the section and length, looked up by the caller
+		vBeam(Eigen::Index id_, const Node& N1, const Node& N2, const Node& N3, size_t _sectionId, const Matrix12d& localStiffness) {
+			id = id_;
+			node1Pos = N1.pos;
+			node2Pos = N2.pos;
+			node3Pos = N3.pos;
+			sectionId = _sectionId;
+			calc_Len(N2, N1);
+			localStiffnessMatrix = &localStiffness;
+			calc_LocalUnitVectors(N1, N2, N3);
+			calc_rotMatrix();
+		}
 
-		vBeam(Eigen::Index id_, const Node& N1, const Node& N2, const Node& N3, size_t _sectionId, const Section& section) {
-			localStiffnessMatrix.resize(12, 12);
-			rotMatrix.resize(12, 12);
+		vBeam(Eigen::Index id_, const Node& N1, const Node& N2, const Node& N3, size_t _sectionId, const Section& section, LocalStiffnessCache& stiffnessCache) {
 			id = id_;
 			
 			node1Pos = N1.pos;
@@ -536,16 +646,16 @@ namespace Beams {
 			sectionId = _sectionId;
 			calc_Len(N2, N1);
 
-			calc_BMatrix(section);
+			localStiffnessMatrix = &stiffnessCache.get(sectionId, section, Len);
 
 			calc_LocalUnitVectors(N1, N2, N3);
 
 			calc_rotMatrix();
 		};
 
-		void reCalc(NodeContainer& Nodes, const Section& section) {
+		void reCalc(NodeContainer& Nodes, const Section& section, LocalStiffnessCache& stiffnessCache) {
 			calc_Len(Nodes.get_byPos(node2Pos), Nodes.get_byPos(node1Pos));
-			calc_BMatrix(section);
+			localStiffnessMatrix = &stiffnessCache.get(sectionId, section, Len);
 			calc_LocalUnitVectors(Nodes.get_byPos(node1Pos), Nodes.get_byPos(node2Pos), Nodes.get_byPos(node3Pos));
 			calc_rotMatrix();
 		}
@@ -554,77 +664,46 @@ namespace Beams {
 			return sectionId;
 		}
 
-		Eigen::Index getID() {
+		Eigen::Index getID() const {
 			return id;
 		}
 
 
-		void LocalMatrix2GlobalTriplets(std::vector<Eigen::Triplet<double>>& globalTriplets, NodeContainer& Nodes, Section& section) {
-			
-
-			
-
-
-			Eigen::SparseMatrix<double> globalB = rotMatrix * localStiffnessMatrix * rotMatrix.transpose();
-			//std::cout << Eigen::MatrixXd(globalB);
-#ifdef DEBUG_PRINTS
-
-			std::cout << "\n\nCOS MATRIX FOR ELEMENT"<< id<<"__________\n"<<Eigen::MatrixXd(cosMatrix)<<"\n\n";
-			std::cout << "\n\n" << globalB.coeff(1, 1)<<'\n';
-#endif // DEBUG_PRINTS
-
-			Eigen::Index nid1 = Nodes.get_byPos(node1Pos).matrixPos;
-			Eigen::Index nid2 = Nodes.get_byPos(node2Pos).matrixPos;
-
-			for (int k = 0; k < 6; ++k)
-			{
-
-				Eigen::SparseMatrix<double>::InnerIterator it(globalB, k);
-				size_t counter = 0;
-				std::ptrdiff_t i;
-				for (i = 0; i < 6; ++i) //local Node 1 for Node 1 in global
-				{
-					Eigen::Index row = (it + i).row(); // row index
-					Eigen::Index col = (it + i).col(); // col index (here it is equal to k)
-					double val = (it + i).value();
-
-					globalTriplets.emplace_back(nid1 * 6 + row, nid1 * 6 + col, val);
-
-				}
-				for (i = 6; it + i; ++i) {
-					Eigen::Index row = (it + i).row(); // row index
-					Eigen::Index col = (it + i).col(); // col index (here it is equal to k)
-					double val = (it + i).value();
-
-					globalTriplets.emplace_back(nid2 * 6 + row - 6, nid1 * 6 + col, val);
-				}
-			}
-			for (int k = 6; k < globalB.outerSize(); ++k)
-			{
-
-				Eigen::SparseMatrix<double>::InnerIterator it(globalB, k);
-				size_t counter = 0;
-				std::ptrdiff_t i;
-				for (i = 0; i < 6; ++i) //local Node 1 for Node 1 in global
-				{
-					Eigen::Index row = (it + i).row(); // row index
-					Eigen::Index col = (it + i).col(); // col index (here it is equal to k)
-					double val = (it + i).value();
+		//Global stiffness matrix R*K*R^T, see rotateToGlobal
+		void calc_GlobalStiffness(Matrix12d& globalB) const {
+			rotateToGlobal(dirCosines, *localStiffnessMatrix, globalB);
+		}
 
+		//y += K*x on the 12 global element dofs without forming the global matrix: rotate x to local axes, multiply, rotate back
+		void applyGlobalStiffness(const Eigen::Matrix<double, 12, 1>& x, Eigen::Matrix<double, 12, 1>& y) const {
+			Eigen::Matrix<double, 12, 1> local;
+			for (int b = 0; b < 4; ++b) local.segment<3>(3 * b) = dirCosines.transpose() * x.segment<3>(3 * b);
+			Eigen::Matrix<double, 12, 1> localForces = *localStiffnessMatrix * local;
+			for (int b = 0; b < 4; ++b) y.segment<3>(3 * b) += dirCosines * localForces.segment<3>(3 * b);
+		}
 
+		//Local end forces (node 1 then node 2, forces then moments) from the 12 global end displacements
+		void calc_LocalEndForces(const Eigen::Matrix<double, 12, 1>& u, Eigen::Matrix<double, 12, 1>& forces) const {
+			Eigen::Matrix<double, 12, 1> local;
+			for (int b = 0; b < 4; ++b) local.segment<3>(3 * b) = dirCosines.transpose() * u.segment<3>(3 * b);
+			forces = *localStiffnessMatrix * local;
+		}
 
-					globalTriplets.emplace_back(nid1 * 6 + row, nid2 * 6 + col - 6, val);
+		const Matrix12d& getLocalStiffness() const {
+			return *localStiffnessMatrix;
+		}
 
-				}
-				for (i = 6; it + i; ++i) {
-					Eigen::Index row = (it + i).row(); // row index
-					Eigen::Index col = (it + i).col(); // col index (here it is equal to k)
-					double val = (it + i).value();
+		//Same matrix at a new place, after LocalStiffnessCache::compact moved it
+		void setLocalStiffness(const Matrix12d& K) {
+			localStiffnessMatrix = &K;
+		}
 
+		double getLength() const {
+			return Len;
+		}
 
-					globalTriplets.emplace_back(nid2 * 6 + row - 6, nid2 * 6 + col - 6, val);
-				}
-			}
+		const Eigen::Matrix3d& getDirCosines() const {
+			return dirCosines;
 		}
 
 
@@ -639,225 +718,1161 @@ namespace Beams {
 	};
 
 
-	class Model {
+	//Read only view of a run of indices
+	struct IndexRange {
+		const size_t* first = nullptr;
+		const size_t* last = nullptr;
 
-		NodeContainer Nodes;
-		std::vector<size_t> nodesPos_InMatrixOrder;
+		const size_t* begin() const { return first; }
+		const size_t* end() const { return last; }
+		size_t size() const { return last - first; }
+		bool empty() const { return first == last; }
+	};
 
-		std::map<size_t,Section> Sections;
-		size_t secIdNext = 0;
+	//Node -> element positions in CSR form over all node slots. A node lists every element that references it, as end or
+	//orientation (3rd) node, in ascending element position. Positions shift when elements are removed, so it is rebuilt lazily.
+	class NodeAdjacency {
+		std::vector<size_t> offsets;
+		std::vector<size_t> elements;
+		bool valid = false;
 
-		std::vector<vBeam> Elements;
-		Eigen::Index eId_Last = 0;
+	public:
+		bool isValid() const {
+			return valid;
+		}
 
+		void invalidate() {
+			valid = false;
+		}
 
-		size_t noDofs = 0;
-		bool solved = false;
+		void build(const std::vector<vBeam>& Elements, size_t noSlots) {
+			offsets.assign(noSlots + 1, 0);
+			auto forEachNode = [](const vBeam& element, auto func) {
+				func(element.node1Pos);
+				if (element.node2Pos != element.node1Pos) func(element.node2Pos);
+				if (element.node3Pos != element.node1Pos && element.node3Pos != element.node2Pos) func(element.node3Pos);
+			};
+			for (auto& element : Elements) forEachNode(element, [&](size_t pos) { offsets[pos + 1]++; });
+			for (size_t i = 0; i < noSlots; i++) offsets[i + 1] += offsets[i];
+
+			elements.resize(offsets.back());
+			std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+			for (size_t ePos = 0; ePos < Elements.size(); ePos++) {
+				forEachNode(Elements[ePos], [&](size_t pos) { elements[fill[pos]++] = ePos; });
+			}
+			valid = true;
+		}
 
-		std::set<size_t> BCpinned;//UNUSED- and going to be unused.
-		std::set<size_t> BCfixed;
-		std::map<size_t, std::array<double, 6>> Forces;//node position to force. Position refers to All nodes, taking into account the deleted stuff.
+		//Element positions referencing the node. Nodes added after the last build have none
+		IndexRange elementsOf(size_t nodePos) const {
+			if (nodePos + 1 >= offsets.size()) return IndexRange();
+			return IndexRange{ elements.data() + offsets[nodePos], elements.data() + offsets[nodePos + 1] };
+		}
+	};
 
-		Eigen::SparseVector<double> U, F;
-		//Raygui does not render large positions well (things far away vanish,  probably because I dont use a custom shader). Thus I divide all deflection data /10
-		//Done here to only do it once and not every frame.
-		Eigen::SparseVector<double> Urender;
-		double scaleFactor = 1; //scale for output deformations
-		
+	//Constrained dofs of a node, bit d constrains local dof d (translations x,y,z then rotations x,y,z)
+	enum DofMask : uint8_t {
+		DOF_UX = 1, DOF_UY = 2, DOF_UZ = 4,
+		DOF_RX = 8, DOF_RY = 16, DOF_RZ = 32,
+		DOF_TRANSLATIONS = DOF_UX | DOF_UY | DOF_UZ,
+		DOF_ALL = DOF_TRANSLATIONS | DOF_RX | DOF_RY | DOF_RZ
+	};
 
-		
+	//Equation numbering of the global dofs: each dof maps to its row in the reduced (constrained) system, or to CONSTRAINED.
+	//Free dofs keep their relative order, so the reduced matrix keeps the column order and sorted rows of the full one.
+	class DofMap {
+		std::vector<Eigen::Index> equation;
+		Eigen::Index noEquations = 0;
 
 	public:
+		static const Eigen::Index CONSTRAINED = -1;
+
+		//nodeMasks has one DofMask per node in matrix order
+		void build(const std::vector<uint8_t>& nodeMasks) {
+			equation.resize(nodeMasks.size() * 6);
+			noEquations = 0;
+			for (size_t m = 0; m < nodeMasks.size(); m++) {
+				for (int d = 0; d < 6; d++) {
+					equation[6 * m + d] = (nodeMasks[m] & (1 << d)) ? CONSTRAINED : noEquations++;
+				}
+			}
+		}
 
-		void addNode(Vector3& point) {
-			Nodes.emplace(point);
+		Eigen::Index operator[](size_t dof) const {
+			return equation[dof];
 		}
 
-		void addNode(Vector3 point) {
-			Nodes.emplace(point);
+		Eigen::Index size() const {
+			return noEquations;
 		}
 
-		//remove node from nth position 
-		void removeNode(size_t pos) {
-			const Node& node =  Nodes.get_byPos(pos);
-
-			size_t elPos = 0;
-			std::set<size_t> toRemove;//Remove from end to beginning. 
-			for (auto& element : Elements) {//iterate elements only once. TODO: change with removeElementId when you do binary search
-				if (std::find(node.inElements.begin(), node.inElements.end(), element.getID()) != node.inElements.end()) {
-					toRemove.insert(elPos);
+		size_t noDofs() const {
+			return equation.size();
+		}
+
+		//Drops constrained rows & columns of the full matrix in one pass over its entries
+		void reduce(const Eigen::SparseMatrix<double>& full, Eigen::SparseMatrix<double>& reduced) const {
+			reduced.resize(noEquations, noEquations);
+			reduced.reserve(full.nonZeros());
+			for (Eigen::Index col = 0; col < full.outerSize(); ++col) {
+				Eigen::Index eqCol = equation[col];
+				if (eqCol == CONSTRAINED) continue;
+				reduced.startVec(eqCol);
+				for (Eigen::SparseMatrix<double>::InnerIterator it(full, col); it; ++it) {
+					Eigen::Index eqRow = equation[it.row()];
+					if (eqRow != CONSTRAINED) reduced.insertBack(eqRow, eqCol) = it.value();
 				}
-				elPos++;
 			}
-			for (auto rit = toRemove.rbegin(); rit != toRemove.rend(); rit++) {
- 				removeElement(*rit);
+			reduced.finalize();
+		}
+	};
+
+	//Elements grouped by colour. Elements of the same colour share no nodes, so they scatter to disjoint dofs.
+	class ElementColoring {
+		std::vector<size_t> elementsByColor;
+		std::vector<size_t> colorOffsets;
+
+	public:
+		void build(const std::vector<vBeam>& Elements, const NodeContainer& Nodes, size_t noMatrixNodes) {
+			//node -> elements in matrix order
+			std::vector<size_t> offsets(noMatrixNodes + 1, 0);
+			for (auto& element : Elements) {
+				offsets[Nodes.get_byPos(element.node1Pos).matrixPos + 1]++;
+				offsets[Nodes.get_byPos(element.node2Pos).matrixPos + 1]++;
+			}
+			for (size_t i = 0; i < noMatrixNodes; i++) offsets[i + 1] += offsets[i];
+			std::vector<size_t> nodeElements(offsets.back());
+			std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+			for (size_t ePos = 0; ePos < Elements.size(); ePos++) {
+				nodeElements[fill[Nodes.get_byPos(Elements[ePos].node1Pos).matrixPos]++] = ePos;
+				nodeElements[fill[Nodes.get_byPos(Elements[ePos].node2Pos).matrixPos]++] = ePos;
 			}
 
-			auto it = Forces.find(pos);
-			if (it != Forces.end()) {
-				Forces.erase(it);
+			//greedy colouring in element order
+			std::vector<size_t> color(Elements.size(), SIZE_MAX);
+			std::vector<size_t> colorStamp;
+			size_t noColors = 0;
+			for (size_t ePos = 0; ePos < Elements.size(); ePos++) {
+				size_t m[2] = { Nodes.get_byPos(Elements[ePos].node1Pos).matrixPos, Nodes.get_byPos(Elements[ePos].node2Pos).matrixPos };
+				for (size_t n : m) {
+					for (size_t k = offsets[n]; k < offsets[n + 1]; k++) {
+						size_t c = color[nodeElements[k]];
+						if (c != SIZE_MAX) colorStamp[c] = ePos;
+					}
+				}
+				size_t c = 0;
+				while (c < noColors && colorStamp[c] == ePos) c++;
+				if (c == noColors) {
+					noColors++;
+					colorStamp.push_back(SIZE_MAX);
+				}
+				color[ePos] = c;
 			}
 
-			auto itB = BCfixed.find(pos);
-			if (itB != BCfixed.end()) BCfixed.erase(itB);
+			colorOffsets.assign(noColors + 1, 0);
+			for (size_t c : color) colorOffsets[c + 1]++;
+			for (size_t c = 0; c < noColors; c++) colorOffsets[c + 1] += colorOffsets[c];
+			elementsByColor.resize(Elements.size());
+			fill.assign(colorOffsets.begin(), colorOffsets.end() - 1);
+			for (size_t ePos = 0; ePos < Elements.size(); ePos++) elementsByColor[fill[color[ePos]]++] = ePos;
+		}
 
-			Nodes.remove(pos);	
+		//func(ePos) for every element. Colours run one after another, so the summation order is fixed and results do not depend on the thread count.
+		template <typename Func>
+		void forEach(unsigned noThreads, Func func) const {
+			for (size_t c = 0; c + 1 < colorOffsets.size(); c++) {
+				size_t colorBegin = colorOffsets[c];
+				parallelFor(colorOffsets[c + 1] - colorBegin, noThreads, [&](size_t begin, size_t end) {
+					for (size_t k = colorBegin + begin; k < colorBegin + end; k++) func(elementsByColor[k]);
+				});
+			}
 		}
+	};
 
-		std::unordered_map<size_t, size_t> findDuplicateNodes() {
-			std::set<Node> originals;
-			std::unordered_map<size_t, size_t> posMap;
+	//Compressed column pattern of the global stiffness matrix and, for every element, the value slot of each of its 144 entries.
+	//Depends only on the topology (which elements connect which nodes), so it is built once and values are re-assembled by scatter-add.
+	class StiffnessPattern {
+		typedef Eigen::SparseMatrix<double>::StorageIndex StorageIndex;
 
-			for (auto& node : Nodes) {
-				auto emplacePair = originals.emplace(node);
-				if (!emplacePair.second) posMap[node.pos] = emplacePair.first->pos;
-			}
+		Eigen::SparseMatrix<double> globalK;
+		std::vector<StorageIndex> elementSlots; //144 per element, column major like the element matrix
 
-			return posMap;
-		}
+		ElementColoring coloring;
 
-		void removeDuplicateNodes(std::unordered_map<size_t, size_t>& posMap) {
-			for (auto& pair : posMap) {
-				size_t duplicateNodePos = pair.first;
-				size_t originalNodePos = pair.second;
-				const Node& originalNode = Nodes.get_byPos(originalNodePos);
-				const Node& duplicateNode = Nodes.get_byPos(duplicateNodePos);
-
-				const std::set<Eigen::Index> inElems = duplicateNode.inElements;//COPY because we remove things from node.inElements
-				for (auto& elementId : inElems) {
-					if (originalNode.free_flag) Nodes.setFree_byPos(originalNodePos, duplicateNode.free_flag);
-					vBeam& element = Elements[getElementPos_byId(elementId)];
-					
-					if (element.node1Pos == duplicateNodePos) element.node1Pos = originalNodePos;
-					else if (element.node2Pos == duplicateNodePos) element.node2Pos = originalNodePos;
-					else if (element.node3Pos == duplicateNodePos) element.node3Pos = originalNodePos;
-					else throw std::runtime_error("Something Failed in removeDuplicateNodes");//for testing purposes. 
-				
-					Nodes.remove_InElement_byPos(duplicateNodePos,elementId);
-				}
+		bool valid = false;
+		bool symmetric = false;
 
+		//Node adjacency in matrix order (node itself included), sorted. Each entry is a 6x6 block of K.
+		static void buildNodeAdjacency(const std::vector<vBeam>& Elements, const NodeContainer& Nodes, size_t noMatrixNodes, std::vector<size_t>& offsets, std::vector<size_t>& neighbours) {
+			offsets.assign(noMatrixNodes + 1, 0);
+			for (auto& element : Elements) {
+				offsets[Nodes.get_byPos(element.node1Pos).matrixPos + 1] += 2;
+				offsets[Nodes.get_byPos(element.node2Pos).matrixPos + 1] += 2;
+			}
+			for (size_t i = 0; i < noMatrixNodes; i++) offsets[i + 1] += offsets[i];
 
-				removeNode(duplicateNodePos);
+			neighbours.resize(offsets.back());
+			std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+			for (auto& element : Elements) {
+				size_t m1 = Nodes.get_byPos(element.node1Pos).matrixPos;
+				size_t m2 = Nodes.get_byPos(element.node2Pos).matrixPos;
+				neighbours[fill[m1]++] = m1;
+				neighbours[fill[m1]++] = m2;
+				neighbours[fill[m2]++] = m2;
+				neighbours[fill[m2]++] = m1;
+			}
 
+			//sort + unique each node's list and compact
+			size_t write = 0;
+			size_t begin = 0;
+			for (size_t i = 0; i < noMatrixNodes; i++) {
+				size_t end = offsets[i + 1];
+				std::sort(neighbours.begin() + begin, neighbours.begin() + end);
+				size_t newBegin = write;
+				for (size_t k = begin; k < end; k++) {
+					if (write == newBegin || neighbours[write - 1] != neighbours[k]) neighbours[write++] = neighbours[k];
+				}
+				offsets[i] = newBegin;
+				begin = end;
 			}
+			offsets[noMatrixNodes] = write;
+			neighbours.resize(write);
 		}
 
-		void removeDuplicateNodes() {
-			std::unordered_map<size_t, size_t> posMap = findDuplicateNodes();
-			removeDuplicateNodes(posMap);
+	public:
+		bool isValid() const {
+			return valid;
 		}
 
-		bool addElement(size_t n1Pos, size_t n2Pos, size_t n3Pos, size_t sectionID) {
+		void invalidate() {
+			valid = false;
+		}
 
-			if (Sections.size() - 1 < sectionID) return false;
-			solved = false;
+		//Nodes must already have their matrixPos set for every element end node.
+		//lowerOnly stores only the lower triangle (row >= col) of the symmetric K. Element entries above the diagonal get slot -1.
+		void build(const std::vector<vBeam>& Elements, const NodeContainer& Nodes, size_t noDofs, bool lowerOnly) {
+			size_t noMatrixNodes = noDofs / 6;
+			std::vector<size_t> offsets, neighbours;
+			buildNodeAdjacency(Elements, Nodes, noMatrixNodes, offsets, neighbours);
+
+			//first stored neighbour of every node. With lowerOnly only neighbours a >= b are kept (lists are sorted)
+			std::vector<size_t> firstStored(noMatrixNodes);
+			size_t noBlocks = 0;
+			for (size_t b = 0; b < noMatrixNodes; b++) {
+				firstStored[b] = lowerOnly ? std::lower_bound(neighbours.begin() + offsets[b], neighbours.begin() + offsets[b + 1], b) - neighbours.begin() : offsets[b];
+				noBlocks += offsets[b + 1] - firstStored[b];
+			}
 
+			//Column 6*b+j holds the 6 rows of every stored neighbour node a of b, in neighbour order.
+			//In lower mode the first neighbour is b itself and only its rows i >= j are stored
+			globalK.resize(noDofs, noDofs);
+			globalK.resizeNonZeros(noBlocks * 36 - (lowerOnly ? noMatrixNodes * 15 : 0));
+			StorageIndex* outer = globalK.outerIndexPtr();
+			StorageIndex* inner = globalK.innerIndexPtr();
+			StorageIndex nnz = 0;
+			for (size_t b = 0; b < noMatrixNodes; b++) {
+				for (int j = 0; j < 6; j++) {
+					outer[6 * b + j] = nnz;
+					for (size_t k = firstStored[b]; k < offsets[b + 1]; k++) {
+						int iStart = (lowerOnly && neighbours[k] == b) ? j : 0;
+						for (int i = iStart; i < 6; i++) inner[nnz++] = (StorageIndex)(6 * neighbours[k] + i);
+					}
+				}
+			}
+			outer[noDofs] = nnz;
+
+			elementSlots.resize(Elements.size() * 144);
+			for (size_t ePos = 0; ePos < Elements.size(); ePos++) {
+				size_t m[2] = { Nodes.get_byPos(Elements[ePos].node1Pos).matrixPos, Nodes.get_byPos(Elements[ePos].node2Pos).matrixPos };
+				StorageIndex* slots = elementSlots.data() + ePos * 144;
+				for (int colNode = 0; colNode < 2; colNode++) {
+					size_t b = m[colNode];
+					for (int rowNode = 0; rowNode < 2; rowNode++) {
+						size_t a = m[rowNode];
+						if (lowerOnly && a < b) {
+							for (int j = 0; j < 6; j++) {
+								for (int i = 0; i < 6; i++) slots[(6 * colNode + j) * 12 + 6 * rowNode + i] = -1;
+							}
+							continue;
+						}
+						size_t blockPos = std::lower_bound(neighbours.begin() + firstStored[b], neighbours.begin() + offsets[b + 1], a) - (neighbours.begin() + firstStored[b]);
+						for (int j = 0; j < 6; j++) {
+							//in lower mode the own block of column j is 6-j long and the other blocks start 6-j later
+							StorageIndex colStart = outer[6 * b + j] + (StorageIndex)(6 * blockPos) - ((lowerOnly && blockPos > 0) ? j : 0);
+							for (int i = 0; i < 6; i++) {
+								if (lowerOnly && a == b) slots[(6 * colNode + j) * 12 + 6 * rowNode + i] = (i >= j) ? colStart + i - j : -1;
+								else slots[(6 * colNode + j) * 12 + 6 * rowNode + i] = colStart + i;
+							}
+						}
+					}
+				}
+			}
 
-			Elements.emplace_back(eId_Last, Nodes.get_byPos(n1Pos), Nodes.get_byPos(n2Pos), Nodes.get_byPos(n3Pos), sectionID, Sections[sectionID]);
-			Sections[sectionID].inElements.emplace_back(eId_Last);
+			coloring.build(Elements, Nodes, noMatrixNodes);
+			symmetric = lowerOnly;
+			valid = true;
+		}
 
-			
+		bool isLowerOnly() const {
+			return symmetric;
+		}
 
-			//Update Nodes that are part of Element
-			Nodes.add_InElement_byPos(n1Pos, eId_Last);
-			Nodes.add_InElement_byPos(n2Pos, eId_Last);
-			Nodes.add_InElement_byPos(n3Pos, eId_Last);
-			Nodes.setFree_byPos(n1Pos, false);
-			Nodes.setFree_byPos(n2Pos, false);
+		//Zeroes the values and scatter-adds every element matrix. Colours run one after another, so the summation order is fixed and results do not depend on the thread count.
+		void assemble(const std::vector<vBeam>& Elements, unsigned noThreads) {
+			std::fill(globalK.valuePtr(), globalK.valuePtr() + globalK.nonZeros(), 0.0);
+			double* values = globalK.valuePtr();
+
+			coloring.forEach(noThreads, [&](size_t ePos) {
+				Matrix12d globalB;
+				Elements[ePos].calc_GlobalStiffness(globalB);
+				const StorageIndex* slots = elementSlots.data() + ePos * 144;
+				const double* val = globalB.data();
+				for (int i = 0; i < 144; i++) {
+					if (slots[i] >= 0) values[slots[i]] += val[i];
+				}
+			});
+		}
 
-			eId_Last++;
-			return true;
+		const Eigen::SparseMatrix<double>& getMatrix() const {
+			return globalK;
 		}
+	};
 
-		bool removeElement(size_t ePos) {
-			if (ePos >= Elements.size()) return false;
+	//Reduced K applied element by element from the local element matrices. Nothing is assembled, so memory is linear in the element count.
+	class ElementOperator {
+		std::vector<Eigen::Index> elementEqs; //12 reduced equations per element, DofMap::CONSTRAINED for fixed dofs
+		std::vector<size_t> elementNodes; //matrix positions of the 2 end nodes per element
+		ElementColoring coloring;
 
-			vBeam& el = Elements[ePos];
+	public:
+		//Nodes must have their matrixPos set and dofMap must be built for the current numbering
+		void build(const std::vector<vBeam>& Elements, const NodeContainer& Nodes, const DofMap& dofMap) {
+			size_t noMatrixNodes = dofMap.noDofs() / 6;
+			elementEqs.resize(Elements.size() * 12);
+			elementNodes.resize(Elements.size() * 2);
+			for (size_t ePos = 0; ePos < Elements.size(); ePos++) {
+				size_t m[2] = { Nodes.get_byPos(Elements[ePos].node1Pos).matrixPos, Nodes.get_byPos(Elements[ePos].node2Pos).matrixPos };
+				elementNodes[2 * ePos] = m[0];
+				elementNodes[2 * ePos + 1] = m[1];
+				for (int i = 0; i < 12; i++) elementEqs[12 * ePos + i] = dofMap[6 * m[i / 6] + i % 6];
+			}
+			coloring.build(Elements, Nodes, noMatrixNodes);
+		}
 
-			solved = false;
+		//y = K*x
+		void apply(const std::vector<vBeam>& Elements, const Eigen::VectorXd& x, Eigen::VectorXd& y, unsigned noThreads) const {
+			y.setZero(x.size());
+			coloring.forEach(noThreads, [&](size_t ePos) {
+				const Eigen::Index* eqs = elementEqs.data() + 12 * ePos;
+				Eigen::Matrix<double, 12, 1> xElement, yElement = Eigen::Matrix<double, 12, 1>::Zero();
+				for (int i = 0; i < 12; i++) xElement(i) = (eqs[i] != DofMap::CONSTRAINED) ? x(eqs[i]) : 0.;
+				Elements[ePos].applyGlobalStiffness(xElement, yElement);
+				for (int i = 0; i < 12; i++) {
+					if (eqs[i] != DofMap::CONSTRAINED) y(eqs[i]) += yElement(i);
+				}
+			});
+		}
 
-			Eigen::Index eId = el.getID();
-			Nodes.remove_InElement_byPos(el.node1Pos, eId);
-			Nodes.remove_InElement_byPos(el.node2Pos, eId);
-			Nodes.remove_InElement_byPos(el.node3Pos, eId);
+		//6x6 diagonal blocks of the full K, one per node in matrix order
+		void nodeBlocks(const std::vector<vBeam>& Elements, size_t noMatrixNodes, std::vector<Eigen::Matrix<double, 6, 6>>& blocks, unsigned noThreads) const {
+			blocks.assign(noMatrixNodes, Eigen::Matrix<double, 6, 6>::Zero());
+			coloring.forEach(noThreads, [&](size_t ePos) {
+				Matrix12d globalB;
+				Elements[ePos].calc_GlobalStiffness(globalB);
+				blocks[elementNodes[2 * ePos]] += globalB.block<6, 6>(0, 0);
+				blocks[elementNodes[2 * ePos + 1]] += globalB.block<6, 6>(6, 6);
+			});
+		}
+	};
 
+	//Disjoint sets with path halving and union by size
+	class UnionFind {
+		std::vector<size_t> parent;
+		std::vector<size_t> setSize;
 
-			
+	public:
+		explicit UnionFind(size_t n) : parent(n), setSize(n, 1) {
+			std::iota(parent.begin(), parent.end(), 0);
+		}
 
-			Elements.erase(Elements.begin() + ePos); 
+		size_t find(size_t a) {
+			while (parent[a] != a) {
+				parent[a] = parent[parent[a]];
+				a = parent[a];
+			}
+			return a;
+		}
 
-			return true;
+		void unite(size_t a, size_t b) {
+			a = find(a);
+			b = find(b);
+			if (a == b) return;
+			if (setSize[a] < setSize[b]) std::swap(a, b);
+			parent[b] = a;
+			setSize[a] += setSize[b];
+		}
+	};
 
+	//Why K could not be factorized. Nodes are node positions as used by the BC & force functions.
+	struct MechanismReport {
+		size_t noComponents = 0; //connected parts of the node-element graph
+		std::vector<std::vector<size_t>> unsupportedComponents; //parts with no supports, or held at a single node that is not fully fixed
+		std::vector<std::pair<size_t, int>> zeroStiffnessDofs; //node & dof (0-5) with a vanishing pivot
+		std::string solverMessage;
 
+		bool isMechanism() const {
+			return !unsupportedComponents.empty() || !zeroStiffnessDofs.empty() || !solverMessage.empty();
 		}
+	};
 
-		void copyElements(std::vector<size_t> ePositions, Vector3 offset) {
-			std::unordered_map<size_t, size_t> nodePosMap;
+	typedef std::map<size_t, std::array<double, 6>> LoadCase;//node position to force. Position refers to All nodes, taking into account the deleted stuff.
+	typedef std::vector<std::pair<std::string, double>> LoadCombination;//load case name & factor
+	static const char* const DEFAULT_LOADCASE = "Default";
 
-			for (auto ePos : ePositions) {
+	class Model {
+	public:
+		static const size_t NO_ELEMENT = SIZE_MAX;
 
-				vBeam& element = Elements[ePos];
+	private:
 
-				auto emplace = nodePosMap.emplace(element.node1Pos, Nodes.get_nextInsertionPos());
-				if (emplace.second) {
-					const Node& node = Nodes.get_byPos(element.node1Pos);
-					addNode(Vector3{ offset.x + (float)node.x, offset.y + (float)node.y, offset.z + (float)node.z });
+		NodeContainer Nodes;
+		std::vector<size_t> nodesPos_InMatrixOrder;
+
+		std::map<size_t,Section> Sections;
+		size_t secIdNext = 0;
+		LocalStiffnessCache stiffnessCache; //local matrices shared by the elements, must outlive Elements
+
+		std::vector<vBeam> Elements;
+		Eigen::Index eId_Last = 0;
+		std::vector<size_t> idToSlot; //element id -> position in Elements, NO_ELEMENT once removed. Ids are never reused
+		NodeAdjacency nodeAdjacency; //invalidated by element changes, rebuilt on the next query
+
+		//beginBatch/commit: elements are queued and built together, revision bumps are collected and applied once
+		struct PendingElement {
+			size_t node1Pos, node2Pos, node3Pos, sectionId;
+		};
+		unsigned batchDepth = 0;
+		std::vector<PendingElement> pendingElements;
+		std::set<size_t> editedSections; //cached matrices to rebuild at commit
+		bool batchPattern = false, batchStiffness = false, batchEdit = false;
+		size_t revision = 0; //bumped by every edit, once per batch. Caches outside the solver (render buffers) key on it
+
+
+		size_t noDofs = 0;
+		bool solved = false;
+		unsigned assemblyThreads = 0; //threads for element kernels in solve. 0 -> all cores, 1 -> serial
+		bool nodesNumbered = false; //matrixPos of the nodes is current. Reset with the stiffness pattern by topology changes
+		StiffnessPattern stiffnessPattern; //invalidated by topology changes only
+		bool symmetricSolve = true; //lower triangle of K & LDLT, false: full K & LU
+		NodeOrdering nodeOrdering = NodeOrdering::AMD; //the LDLT factorization uses this order as is
+		OrderingStats orderingBefore, orderingAfter; //node block stats of the last numbering, before/after reordering
+
+		std::set<size_t> BCpinned;//translations fixed, rotations free
+		std::set<size_t> BCfixed;
+		std::map<size_t, uint8_t> BCmasks;//node position to DofMask of arbitrary constrained dofs
+		DofMap dofMap; //rebuilt at every solve from the BCs
+		std::map<std::string, LoadCase> LoadCases{ { DEFAULT_LOADCASE, LoadCase{} } };
+		std::map<std::string, LoadCombination> LoadCombinations;
+		std::string activeLoadCase = DEFAULT_LOADCASE; //the case addForce/removeForce/getForces work on
+		std::string displayedResult = DEFAULT_LOADCASE; //load case or combination held in U/Urender
+
+		//Factorization of the reduced K. Reused by solve() until stiffnessRevision changes, so load-only changes cost substitutions only.
+		enum class Factorization { None, LDLT, CachedLDLT, LU, DenseLU };
+		Factorization factorization = Factorization::None;
+		std::unique_ptr<Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>, Eigen::Lower, Eigen::NaturalOrdering<int>>> ldlt; //already fill-reduced by reorderNodes
+		std::unique_ptr<CachedFactor> cachedFactor; //LDLT factor read from factorCache instead of computed
+		FactorCache factorCache; //off until setFactorCache
+		std::unique_ptr<Eigen::SparseLU<Eigen::SparseMatrix<double>>> lu;
+		std::unique_ptr<Eigen::PartialPivLU<Eigen::MatrixXd>> denseLU; //only for mechanisms, and only if allowed
+		bool allowDenseFallback = false;
+		size_t denseFallbackMaxEquations = 600;
+		MechanismReport mechanismReport; //of the last factorization
+		size_t stiffnessRevision = 0; //bumped by every change of K: topology, sections, BCs, solver settings
+		size_t factorizedRevision = SIZE_MAX;
+		size_t patternRevision = 0; //bumped by changes of the reduced K pattern only. Value-only changes (sections) reuse the symbolic analysis
+		size_t analyzedRevision = SIZE_MAX;
+
+		//Iterative solver. The element operator depends on the dof numbering, the preconditioner on the values of K
+		SolverMode solverMode = SolverMode::Direct;
+		PCGSettings pcgSettings;
+		ElementOperator elementOperator;
+		Preconditioner builtPreconditioner = Preconditioner::None; //IC0 falls back to block Jacobi if it breaks down
+		BlockJacobi blockJacobi;
+		IncompleteCholesky0 ic0;
+		size_t operatorRevision = SIZE_MAX; //patternRevision of elementOperator
+		size_t preconditionedRevision = SIZE_MAX; //stiffnessRevision of the preconditioner
+		std::map<std::string, PCGReport> pcgReports; //of the last iterative solve, per load case
+
+		std::vector<std::string> solvedCases; //column order of caseResults
+		std::vector<std::string> previousCases; //solvedCases of the solve before, for warm starts
+		size_t resultsRevision = SIZE_MAX; //patternRevision caseResults were solved with, warm starts need the same numbering
+		Eigen::MatrixXd caseResults; //reduced displacements, one column per load case
+
+		//Displayed result and active load case forces, 6 dofs per node in matrix order. Constrained dofs hold 0, so a node's values are at 6*matrixPos.
+		Eigen::VectorXd U, F;
+		//Raygui does not render large positions well (things far away vanish,  probably because I dont use a custom shader). Thus I divide all deflection data /10
+		//Done here to only do it once and not every frame. One entry per node in matrix order.
+		std::vector<Vector3> Urender;
+		double scaleFactor = 1; //scale for output deformations
+		
+
+		
+
+		//K values changed, its pattern did not
+		void stiffnessChanged() {
+			solved = false;
+			if (batchDepth) {
+				batchStiffness = true;
+				return;
+			}
+			stiffnessRevision++;
+			revision++;
+		}
+
+		//pattern of the reduced K changed (topology, BCs, solver settings), the symbolic analysis has to be redone
+		void patternChanged() {
+			solved = false;
+			if (batchDepth) {
+				batchPattern = true;
+				return;
+			}
+			patternRevision++;
+			stiffnessChanged();
+		}
+
+		//nodes or loads changed, K did not
+		void modelEdited() {
+			if (batchDepth) batchEdit = true;
+			else revision++;
+		}
+
+		//Appends n elements, element(k) gives the k-th as a PendingElement. Lengths and frames on the assembly threads, the cache
+		//lookups in between serially (the cache is not thread safe, and regular models hit it almost every time). Node element
+		//end counts have to be done by the caller.
+		template <typename GetElement>
+		void buildElements(size_t n, GetElement element) {
+			if (n == 0) return;
+			size_t first = Elements.size();
+
+			std::vector<double> lengths(n);
+			parallelFor(n, assemblyThreads, [&](size_t begin, size_t end) {
+				for (size_t k = begin; k < end; k++) {
+					PendingElement e = element(k);
+					lengths[k] = vBeam::lengthBetween(Nodes.get_byPos(e.node1Pos), Nodes.get_byPos(e.node2Pos));
 				}
-				emplace = nodePosMap.emplace(element.node2Pos, Nodes.get_nextInsertionPos());
-				if (emplace.second) {
-					const Node& node = Nodes.get_byPos(element.node2Pos);
-					addNode(Vector3{ offset.x + (float)node.x, offset.y + (float)node.y, offset.z + (float)node.z });
+			});
+			std::vector<const Matrix12d*> matrices(n);
+			Section* section = nullptr;
+			size_t lastSection = SIZE_MAX;
+			for (size_t k = 0; k < n; k++) {
+				size_t secId = element(k).sectionId;
+				if (secId != lastSection) {
+					section = &Sections[secId];
+					lastSection = secId;
 				}
-				emplace = nodePosMap.emplace(element.node3Pos, Nodes.get_nextInsertionPos());
-				if (emplace.second) {
-					const Node& node = Nodes.get_byPos(element.node3Pos);
-					addNode(Vector3{ offset.x + (float)node.x, offset.y + (float)node.y, offset.z + (float)node.z });
+				matrices[k] = &stiffnessCache.get(secId, *section, lengths[k]);
+				section->inElements.push_back(first + k);
+			}
+
+			Elements.resize(first + n);
+			parallelFor(n, assemblyThreads, [&](size_t begin, size_t end) {
+				for (size_t k = begin; k < end; k++) {
+					PendingElement e = element(k);
+					Elements[first + k] = vBeam(eId_Last + (Eigen::Index)k, Nodes.get_byPos(e.node1Pos), Nodes.get_byPos(e.node2Pos), Nodes.get_byPos(e.node3Pos), e.sectionId, *matrices[k]);
 				}
+			});
+
+			//indexed by id, which runs ahead of the slot once elements were removed
+			for (size_t k = 0; k < n; k++) idToSlot.push_back(first + k);
+			eId_Last += (Eigen::Index)n;
+		}
+
+		//Builds the queued elements. Node element end counts are already done.
+		void buildPendingElements() {
+			buildElements(pendingElements.size(), [&](size_t k) {return pendingElements[k]; });
+			pendingElements.clear();
+		}
+
+		//Everything queued so far: elements, section matrices and one bump of each collected revision. The batch stays open.
+		void flushBatch() {
+			buildPendingElements();
+			for (size_t secId : editedSections) stiffnessCache.updateSection(secId, Sections[secId], assemblyThreads);
+			editedSections.clear();
+
+			unsigned depth = batchDepth;
+			batchDepth = 0;
+			if (batchPattern) patternChanged();
+			else if (batchStiffness) stiffnessChanged();
+			else if (batchEdit) modelEdited();
+			batchPattern = batchStiffness = batchEdit = false;
+			batchDepth = depth;
+		}
+
+		const NodeAdjacency& adjacency() {
+			flushBatch();
+			if (!nodeAdjacency.isValid()) nodeAdjacency.build(Elements, Nodes.slotCount());
+			return nodeAdjacency;
+		}
 
-				addElement(nodePosMap[element.node1Pos], nodePosMap[element.node2Pos], nodePosMap[element.node3Pos], element.getSectionId());
+		//Forces, BCs & the slot of a node no element references anymore
+		void dropNode(size_t pos) {
+			for (auto& loadCase : LoadCases) loadCase.second.erase(pos);
+			BCfixed.erase(pos);
+			BCpinned.erase(pos);
+			BCmasks.erase(pos);
+			Nodes.remove(pos);
+		}
+
+		//After elements were removed or moved: drops the local matrices no element uses and points the elements at the kept ones
+		void compactStiffnessCache() {
+			std::vector<const Matrix12d*> matrices(Elements.size());
+			for (size_t ePos = 0; ePos < Elements.size(); ePos++) matrices[ePos] = &Elements[ePos].getLocalStiffness();
+			stiffnessCache.compact(matrices);
+			for (size_t ePos = 0; ePos < Elements.size(); ePos++) Elements[ePos].setLocalStiffness(*matrices[ePos]);
+		}
+
+		LoadCase& activeForces() {
+			return LoadCases[activeLoadCase];
+		}
+
+		//Node dof positions in the stiffness matrix, in the order the element end nodes appear
+		void numberDofs() {
+			nodesPos_InMatrixOrder.clear();
+			noDofs = 0;
+			std::unordered_set<size_t> included;
+			for (auto& element : Elements) {
+				size_t n1Pos = element.node1Pos;
+				size_t n2Pos = element.node2Pos;
+
+
+				if (included.emplace(n1Pos).second) {
+					Nodes.setMatrixPos_byPos(n1Pos, nodesPos_InMatrixOrder.size());
+					nodesPos_InMatrixOrder.push_back(n1Pos);
+					noDofs += 6;
+				}
+
+				if (included.emplace(n2Pos).second) {
+					Nodes.setMatrixPos_byPos(n2Pos, nodesPos_InMatrixOrder.size());
+					nodesPos_InMatrixOrder.push_back(n2Pos);
+					noDofs += 6;
+				}
 			}
 		}
-		
-		std::vector<size_t> findDuplicateElements() {
-			std::map<std::pair<size_t,size_t>,size_t> originals;
-			std::vector<size_t> pos;
 
-			size_t elPosition = 0;
+		//numberDofs() & reorderNodes() if the topology changed since the last numbering
+		void updateNumbering() {
+			if (nodesNumbered) return;
+			numberDofs();
+			reorderNodes();
+			nodesNumbered = true;
+			stiffnessPattern.invalidate();
+		}
+
+		//Renumbers the nodes of numberDofs() on the node graph (6 dof blocks) and records the bandwidth/profile/fill before and after
+		void reorderNodes() {
+			size_t noMatrixNodes = nodesPos_InMatrixOrder.size();
+			std::vector<std::pair<size_t, size_t>> edges;
+			edges.reserve(Elements.size());
 			for (auto& element : Elements) {
-				auto emplacePair = originals.emplace(std::make_pair(element.node1Pos, element.node2Pos), elPosition);
-				if (!emplacePair.second) pos.push_back(elPosition);
-				++elPosition;
+				edges.emplace_back(Nodes.get_byPos(element.node1Pos).matrixPos, Nodes.get_byPos(element.node2Pos).matrixPos);
+			}
+			NodeGraph graph;
+			graph.build(noMatrixNodes, edges);
+
+			std::vector<size_t> order(noMatrixNodes);
+			std::iota(order.begin(), order.end(), 0);
+			orderingBefore = Ordering::stats(graph, order);
+			if (nodeOrdering == NodeOrdering::None) {
+				orderingAfter = orderingBefore;
+				return;
 			}
 
-			return pos;
+			order = Ordering::compute(graph, nodeOrdering);
+			orderingAfter = Ordering::stats(graph, order);
 
+			std::vector<size_t> reordered(noMatrixNodes);
+			for (size_t i = 0; i < noMatrixNodes; i++) {
+				reordered[i] = nodesPos_InMatrixOrder[order[i]];
+				Nodes.setMatrixPos_byPos(reordered[i], i);
+			}
+			nodesPos_InMatrixOrder.swap(reordered);
+
+			std::cout << "Node reordering (6 dof blocks): bandwidth " << orderingBefore.bandwidth << " -> " << orderingAfter.bandwidth
+				<< ", profile " << orderingBefore.profile << " -> " << orderingAfter.profile
+				<< ", fill-in " << orderingBefore.fillIn << " -> " << orderingAfter.fillIn << "\n";
 		}
 
-		void removeDuplicateElems(std::vector<size_t>& posMap) {
-			std::sort(posMap.rbegin(), posMap.rend());//inverse sort the element positions to remove from end and not ivalidate positions
+		//true if the node at pos is an element end node of the current numbering, i.e. has dofs in the stiffness matrix
+		bool isInMatrix(size_t pos) {
+			size_t matrixPos = Nodes.get_byPos(pos).matrixPos;
+			return matrixPos < nodesPos_InMatrixOrder.size() && nodesPos_InMatrixOrder[matrixPos] == pos;
+		}
 
-			for (auto& duplicateElemPos : posMap) {
-				
-				vBeam& duplicateElem = Elements[duplicateElemPos];
+		//DofMask of every node in matrix order
+		std::vector<uint8_t> constrainedMasks() {
+			std::vector<uint8_t> nodeMasks(nodesPos_InMatrixOrder.size(), 0);
+			auto applyMask = [&](size_t pos, uint8_t mask) {
+				if (isInMatrix(pos)) nodeMasks[Nodes.get_byPos(pos).matrixPos] |= mask;
+			};
+			for (size_t pos : BCfixed) applyMask(pos, DOF_ALL);
+			for (size_t pos : BCpinned) applyMask(pos, DOF_TRANSLATIONS);
+			for (auto& bc : BCmasks) applyMask(bc.first, bc.second);
+			return nodeMasks;
+		}
 
-				removeElement(duplicateElemPos);
+		void buildDofMap() {
+			dofMap.build(constrainedMasks());
+		}
 
-				
+		//Union-find over the elements. A part of the model is a mechanism if nothing supports it or if it hangs on a single
+		//node that is not fully fixed (it can rotate about it). Fills mechanismReport, returns false if a part is unsupported.
+		bool checkSupports() {
+			const size_t none = SIZE_MAX;
+			size_t noMatrixNodes = nodesPos_InMatrixOrder.size();
+			UnionFind parts(noMatrixNodes);
+			for (auto& element : Elements) parts.unite(Nodes.get_byPos(element.node1Pos).matrixPos, Nodes.get_byPos(element.node2Pos).matrixPos);
+
+			std::vector<uint8_t> masks = constrainedMasks();
+			std::vector<size_t> supportNode(noMatrixNodes, none); //per root: the supported node, or noMatrixNodes if there are several
+			for (size_t m = 0; m < noMatrixNodes; m++) {
+				if (!masks[m]) continue;
+				size_t& support = supportNode[parts.find(m)];
+				support = (support == none) ? m : noMatrixNodes;
 			}
+
+			std::vector<size_t> reportSlot(noMatrixNodes, none);
+			mechanismReport.noComponents = 0;
+			for (size_t m = 0; m < noMatrixNodes; m++) {
+				size_t root = parts.find(m);
+				if (root == m) mechanismReport.noComponents++;
+				size_t support = supportNode[root];
+				if (support == noMatrixNodes || (support != none && masks[support] == DOF_ALL)) continue;
+				if (reportSlot[root] == none) {
+					reportSlot[root] = mechanismReport.unsupportedComponents.size();
+					mechanismReport.unsupportedComponents.emplace_back();
+				}
+				mechanismReport.unsupportedComponents[reportSlot[root]].push_back(nodesPos_InMatrixOrder[m]);
+			}
+			for (auto& component : mechanismReport.unsupportedComponents) std::sort(component.begin(), component.end());
+			std::sort(mechanismReport.unsupportedComponents.begin(), mechanismReport.unsupportedComponents.end());
+			return mechanismReport.unsupportedComponents.empty();
 		}
 
-		void removeDuplicateElems() {
-			std::vector<size_t> a = findDuplicateElements();
-			removeDuplicateElems(a);
+		//Pivot monitoring: equations whose LDLT pivot is not positive or negligible against the diagonal of K have no stiffness of their own
+		void recordZeroPivots(const Eigen::VectorXd& pivots, const Eigen::VectorXd& diagonal) {
+			for (size_t dof = 0; dof < dofMap.noDofs(); dof++) {
+				Eigen::Index eq = dofMap[dof];
+				if (eq == DofMap::CONSTRAINED || eq >= pivots.size()) continue;
+				if (pivots(eq) > ERR_TOLERANCE * std::abs(diagonal(eq))) continue;
+				mechanismReport.zeroStiffnessDofs.emplace_back(nodesPos_InMatrixOrder[dof / 6], (int)(dof % 6));
+			}
 		}
 
-		size_t getElementPos_byId(Eigen::Index id) {
-			auto comparer = [](vBeam& e1, Eigen::Index val) {return e1.getID() < val; };
+		template <typename LDLT>
+		void recordZeroPivots(const LDLT& factor, const Eigen::SparseMatrix<double>& reducedK) {
+			Eigen::VectorXd pivots = factor.vectorD();
+			if (factor.info() != Eigen::Success) {
+				//Eigen stops at the first exactly zero pivot, the ones after it were not computed
+				Eigen::Index stop = 0;
+				while (stop < pivots.size() && pivots(stop) != 0) stop++;
+				pivots.conservativeResize(std::min(stop + 1, pivots.size()));
+			}
+			recordZeroPivots(pivots, reducedK.diagonal());
+		}
 
-			auto i = std::lower_bound(Elements.begin(), Elements.end(), id, comparer);
-			if (i == Elements.end()) return -1;
-			while (i->getID() != id) ++i;
-			return i - Elements.begin();
+		void printMechanismReport() const {
+			std::cout << "Model is a mechanism: " << mechanismReport.unsupportedComponents.size() << " of " << mechanismReport.noComponents
+				<< " parts unsupported, " << mechanismReport.zeroStiffnessDofs.size() << " dofs without stiffness\n";
+			for (auto& component : mechanismReport.unsupportedComponents) {
+				std::cout << "  unsupported part of " << component.size() << " nodes, first node " << component.front() << "\n";
+			}
+			for (size_t i = 0; i < mechanismReport.zeroStiffnessDofs.size() && i < 20; i++) {
+				std::cout << "  node " << mechanismReport.zeroStiffnessDofs[i].first << " dof " << mechanismReport.zeroStiffnessDofs[i].second << "\n";
+			}
+			if (!mechanismReport.solverMessage.empty()) std::cout << "  " << mechanismReport.solverMessage << "\n";
+		}
+
+		bool denseFallbackAllowed(Eigen::Index noEquations) const {
+			return allowDenseFallback && (size_t)noEquations <= denseFallbackMaxEquations;
+		}
+
+	public:
+
+		//Starts (or nests) a batch of edits and reserves room for the given number of additional nodes and elements.
+		//Inside a batch addElement only queues, and the invalidation of solver data happens once at commit. Queries that need
+		//the elements (getElements, removals, solve) build the queue first, the batch stays open.
+		void beginBatch(size_t noNodes = 0, size_t noElements = 0) {
+			batchDepth++;
+			reserve(noNodes, noElements);
+		}
+
+		//Capacity for the given number of additional nodes and elements
+		void reserve(size_t noNodes, size_t noElements) {
+			Nodes.reserve(noNodes);
+			Elements.reserve(Elements.size() + pendingElements.size() + noElements);
+			idToSlot.reserve(idToSlot.size() + pendingElements.size() + noElements);
+			if (batchDepth) pendingElements.reserve(pendingElements.size() + noElements);
+		}
+
+		//Ends the innermost batch. The outermost one builds the queued elements and bumps the revisions once
+		void commit() {
+			if (batchDepth == 0) return;
+			if (batchDepth == 1) flushBatch();
+			batchDepth--;
+		}
+
+		bool inBatch() const {
+			return batchDepth > 0;
+		}
+
+		//Bumped once by every edit outside a batch and once by every committed batch
+		size_t getRevision() const {
+			return revision;
+		}
+
+		void addNode(Vector3& point) {
+			Nodes.emplace(point);
+			modelEdited();
+		}
+
+		void addNode(Vector3 point) {
+			Nodes.emplace(point);
+			modelEdited();
+		}
+
+		//Full precision, for loading files
+		void addNode(double x, double y, double z) {
+			Nodes.emplace(x, y, z);
+			modelEdited();
+		}
+
+		//count nodes from coordinate arrays, filled on the assembly threads. They get the next free positions after the last
+		//slot, deleted slots are not reused.
+		void addNodes(size_t count, const double* x, const double* y, const double* z) {
+			Nodes.append(count, x, y, z, assemblyThreads);
+			modelEdited();
+		}
+
+		//remove node from nth position 
+		//Returns the element position remap of removeElements
+		std::vector<size_t> removeNode(size_t pos) {
+			return removeNodes({ pos });
+		}
+
+		//Removes the nodes and, in one pass, every element referencing them. Returns the element position remap of removeElements
+		std::vector<size_t> removeNodes(const std::vector<size_t>& positions) {
+			const NodeAdjacency& adj = adjacency();
+			std::vector<size_t> toRemove;
+			for (size_t pos : positions) {
+				IndexRange connected = adj.elementsOf(pos);
+				toRemove.insert(toRemove.end(), connected.begin(), connected.end());
+			}
+			std::vector<size_t> remap = removeElements(toRemove);
+
+			for (size_t pos : positions) {
+				if (!Nodes.isDeleted(pos)) dropNode(pos);
+			}
+			stiffnessPattern.invalidate();
+			nodesNumbered = false;
+			patternChanged();
+			return remap;
+		}
+
+		//Drops the slots of deleted nodes so positions are dense again, and remaps the node references of elements, forces & BCs in one pass.
+		//K and the results do not change. Returns old position -> new position (SIZE_MAX for deleted nodes), e.g. to remap a selection.
+		std::vector<size_t> compactNodes() {
+			flushBatch();
+			std::vector<size_t> remap = Nodes.compact();
+			for (auto& element : Elements) {
+				element.node1Pos = remap[element.node1Pos];
+				element.node2Pos = remap[element.node2Pos];
+				element.node3Pos = remap[element.node3Pos];
+			}
+			for (auto& pos : nodesPos_InMatrixOrder) pos = remap[pos];
+			nodeAdjacency.invalidate();
+
+			//the remap keeps the order, so the sorted containers are refilled at their end
+			for (auto& loadCase : LoadCases) {
+				LoadCase remapped;
+				for (auto& force : loadCase.second) remapped.emplace_hint(remapped.end(), remap[force.first], force.second);
+				loadCase.second.swap(remapped);
+			}
+			std::set<size_t> fixed, pinned;
+			std::map<size_t, uint8_t> masks;
+			for (size_t pos : BCfixed) fixed.emplace_hint(fixed.end(), remap[pos]);
+			for (size_t pos : BCpinned) pinned.emplace_hint(pinned.end(), remap[pos]);
+			for (auto& bc : BCmasks) masks.emplace_hint(masks.end(), remap[bc.first], bc.second);
+			BCfixed.swap(fixed);
+			BCpinned.swap(pinned);
+			BCmasks.swap(masks);
+			return remap;
+		}
+
+		//Duplicate node position -> position of the node that replaces it (the lowest position within tolerance on every axis).
+		//Spatial hash on a grid of cells 4x the tolerance, a node probes only the 1 to 8 cells its tolerance box touches.
+		std::unordered_map<size_t, size_t> findDuplicateNodes(double tolerance = ERR_TOLERANCE) {
+			std::vector<size_t> positions;
+			positions.reserve(Nodes.size());
+			for (auto& node : Nodes) positions.push_back(node.pos);
+			std::sort(positions.begin(), positions.end());
+
+			std::vector<std::array<double, 3>> points(positions.size());
+			for (size_t k = 0; k < positions.size(); k++) {
+				const Node& node = Nodes.get_byPos(positions[k]);
+				points[k] = { node.x, node.y, node.z };
+			}
+			std::vector<size_t> canonical = Duplicates::canonicalPoints(points, tolerance, [&](size_t count, auto func) { parallelFor(count, assemblyThreads, func); });
+
+			std::unordered_map<size_t, size_t> posMap;
+			posMap.reserve(positions.size() / 4);
+			for (size_t k = 0; k < positions.size(); k++) {
+				if (canonical[k] != k) posMap[positions[k]] = positions[canonical[k]];
+			}
+			return posMap;
+		}
+
+		//posMap: duplicate node position -> node that replaces it. Elements are remapped in one pass, then the duplicates are dropped.
+		void removeDuplicateNodes(std::unordered_map<size_t, size_t>& posMap) {
+			if (posMap.empty()) return;
+			flushBatch();
+			std::vector<size_t> target(Nodes.slotCount());
+			std::iota(target.begin(), target.end(), 0);
+			for (auto& pair : posMap) target[pair.first] = pair.second;
+			for (auto& pair : posMap) {//the replacement may itself be a duplicate
+				size_t t = pair.second;
+				for (size_t hops = 0; target[t] != t && hops < posMap.size(); hops++) t = target[t];
+				target[pair.first] = (t == pair.first) ? pair.first : t;
+			}
+
+			//moved elements get the geometry of the nodes they now join, their old local matrices are dropped below
+			bool moved = false;
+			for (auto& element : Elements) {
+				bool elementMoved = false;
+				for (size_t* nodePos : { &element.node1Pos, &element.node2Pos }) {
+					size_t t = target[*nodePos];
+					if (t == *nodePos) continue;
+					Nodes.removeElementEnd_byPos(*nodePos);
+					Nodes.addElementEnd_byPos(t);
+					*nodePos = t;
+					elementMoved = true;
+				}
+				if (target[element.node3Pos] != element.node3Pos) {
+					element.node3Pos = target[element.node3Pos];
+					elementMoved = true;
+				}
+				//an element collapsed onto one node keeps its old geometry, it has no length to compute one from
+				if (elementMoved && element.node1Pos != element.node2Pos) element.reCalc(Nodes, Sections[element.getSectionId()], stiffnessCache);
+				moved = moved || elementMoved;
+			}
+			if (moved) compactStiffnessCache();
+
+			for (auto& pair : posMap) {
+				if (target[pair.first] != pair.first && !Nodes.isDeleted(pair.first)) dropNode(pair.first);
+			}
+			nodeAdjacency.invalidate();
+			stiffnessPattern.invalidate();
+			nodesNumbered = false;
+			patternChanged();
+		}
+
+		void removeDuplicateNodes() {
+			std::unordered_map<size_t, size_t> posMap = findDuplicateNodes();
+			removeDuplicateNodes(posMap);
+		}
+
+		//Positions of the elements referencing the node as end or orientation node, ascending. Valid until the elements change
+		IndexRange getConnectedElements(size_t nodePos) {
+			return adjacency().elementsOf(nodePos);
+		}
+
+		//Nodes at the other end of the elements that have the node as end node, ascending
+		std::vector<size_t> getConnectedNodes(size_t nodePos) {
+			std::vector<size_t> connected;
+			for (size_t ePos : adjacency().elementsOf(nodePos)) {
+				const vBeam& element = Elements[ePos];
+				if (element.node1Pos == nodePos && element.node2Pos != nodePos) connected.push_back(element.node2Pos);
+				else if (element.node2Pos == nodePos && element.node1Pos != nodePos) connected.push_back(element.node1Pos);
+			}
+			std::sort(connected.begin(), connected.end());
+			connected.erase(std::unique(connected.begin(), connected.end()), connected.end());
+			return connected;
+		}
+
+		bool addElement(size_t n1Pos, size_t n2Pos, size_t n3Pos, size_t sectionID) {
+
+			if (Sections.size() - 1 < sectionID) return false;
+			patternChanged();
+			stiffnessPattern.invalidate();
+			nodesNumbered = false;
+
+			if (batchDepth) {
+				pendingElements.push_back(PendingElement{ n1Pos, n2Pos, n3Pos, sectionID });
+				Nodes.addElementEnd_byPos(n1Pos); //counted right away, BCs check free_flag
+				Nodes.addElementEnd_byPos(n2Pos);
+				nodeAdjacency.invalidate();
+				return true;
+			}
+
+			Elements.emplace_back(eId_Last, Nodes.get_byPos(n1Pos), Nodes.get_byPos(n2Pos), Nodes.get_byPos(n3Pos), sectionID, Sections[sectionID], stiffnessCache);
+			Sections[sectionID].inElements.emplace_back(Elements.size() - 1);
+			idToSlot.push_back(Elements.size() - 1);
+
+			
+
+			//Update Nodes that are part of Element
+			Nodes.addElementEnd_byPos(n1Pos);
+			Nodes.addElementEnd_byPos(n2Pos);
+			nodeAdjacency.invalidate();
+
+			eId_Last++;
+			return true;
+		}
+
+		//count elements from index arrays, for loaders. References are checked on the assembly threads first, nothing is
+		//added if one is bad. Element ends are counted once for all of them, then the elements are built like a batch.
+		template <typename Index>
+		bool addElements(size_t count, const Index* n1Pos, const Index* n2Pos, const Index* n3Pos, const Index* sectionIDs) {
+			if (count == 0) return true;
+			size_t noSlots = Nodes.slotCount(), noSections = Sections.size();
+			auto liveNode = [&](Index pos) {return (size_t)pos < noSlots && !Nodes.isDeleted((size_t)pos); };
+			std::atomic<bool> valid(true);
+			parallelFor(count, assemblyThreads, [&](size_t begin, size_t end) {
+				for (size_t k = begin; k < end && valid.load(std::memory_order_relaxed); k++) {
+					if (!liveNode(n1Pos[k]) || !liveNode(n2Pos[k]) || !liveNode(n3Pos[k]) || (size_t)sectionIDs[k] >= noSections) valid = false;
+				}
+			});
+			if (!valid) return false;
+
+			buildPendingElements(); //keeps the element order
+			patternChanged();
+			stiffnessPattern.invalidate();
+			nodesNumbered = false;
+			nodeAdjacency.invalidate();
+			for (size_t k = 0; k < count; k++) {
+				Nodes.addElementEnd_byPos((size_t)n1Pos[k]);
+				Nodes.addElementEnd_byPos((size_t)n2Pos[k]);
+			}
+			buildElements(count, [&](size_t k) {
+				return PendingElement{ (size_t)n1Pos[k], (size_t)n2Pos[k], (size_t)n3Pos[k], (size_t)sectionIDs[k] };
+			});
+			return true;
+		}
+
+		bool removeElement(size_t ePos) {
+			if (ePos >= Elements.size()) return false;
+			removeElements({ ePos });
+			return true;
+		}
+
+		//Removes all given element positions (any order, duplicates & out of range ones are ignored) with one compaction pass.
+		//Ids of the remaining elements do not change. Returns old position -> new position, NO_ELEMENT for removed ones.
+		std::vector<size_t> removeElements(const std::vector<size_t>& ePositions) {
+			flushBatch();
+			std::vector<char> removed(Elements.size(), 0);
+			bool any = false;
+			for (size_t ePos : ePositions) {
+				if (ePos >= Elements.size()) continue;
+				removed[ePos] = 1;
+				any = true;
+			}
+
+			std::vector<size_t> remap(Elements.size());
+			std::iota(remap.begin(), remap.end(), 0);
+			if (!any) return remap;
+
+			size_t write = 0;
+			for (size_t ePos = 0; ePos < Elements.size(); ePos++) {
+				vBeam& element = Elements[ePos];
+				if (removed[ePos]) {
+					Nodes.removeElementEnd_byPos(element.node1Pos);
+					Nodes.removeElementEnd_byPos(element.node2Pos);
+					idToSlot[element.getID()] = NO_ELEMENT;
+					remap[ePos] = NO_ELEMENT;
+					continue;
+				}
+				if (write != ePos) Elements[write] = std::move(element);
+				idToSlot[Elements[write].getID()] = write;
+				remap[ePos] = write++;
+			}
+			Elements.erase(Elements.begin() + write, Elements.end());
+			compactStiffnessCache();
+
+			//compaction keeps the order, so the remapped lists stay ascending
+			for (auto& secPair : Sections) {
+				std::vector<size_t>& inElements = secPair.second.inElements;
+				size_t kept = 0;
+				for (size_t ePos : inElements) {
+					if (remap[ePos] != NO_ELEMENT) inElements[kept++] = remap[ePos];
+				}
+				inElements.resize(kept);
+			}
+
+			patternChanged();
+			stiffnessPattern.invalidate();
+			nodesNumbered = false;
+			nodeAdjacency.invalidate();
+			return remap;
+		}
+
+		void copyElements(std::vector<size_t> ePositions, Vector3 offset) {
+			std::unordered_map<size_t, size_t> nodePosMap;
+			flushBatch();
+			beginBatch(3 * ePositions.size(), ePositions.size());
+
+			//new node position of a copied node, the node is added on first use
+			auto copyNode = [&](size_t pos) {
+				auto emplace = nodePosMap.emplace(pos, Nodes.get_nextInsertionPos());
+				if (emplace.second) {
+					const Node& node = Nodes.get_byPos(pos);
+					addNode(offset.x + node.x, offset.y + node.y, offset.z + node.z);
+				}
+				return emplace.first->second;
+			};
+
+			for (auto ePos : ePositions) {
+				//by value, Elements is not referenced across the adds
+				size_t node1Pos = Elements[ePos].node1Pos, node2Pos = Elements[ePos].node2Pos, node3Pos = Elements[ePos].node3Pos;
+				size_t sectionId = Elements[ePos].getSectionId();
+
+				size_t newNode1 = copyNode(node1Pos);
+				size_t newNode2 = copyNode(node2Pos);
+				size_t newNode3 = copyNode(node3Pos);
+				addElement(newNode1, newNode2, newNode3, sectionId);
+			}
+			commit();
+		}
+		
+		//Groups of element positions joining the same two nodes in either direction (optionally with the same section).
+		//Each group is ascending, group[0] is kept by removeDuplicateElems. Large models use the parallel sort instead of the hash table.
+		std::vector<std::vector<size_t>> findDuplicateElements(bool matchSection = false) {
+			flushBatch();
+			std::vector<Duplicates::ElementKey> keys(Elements.size());
+			parallelFor(Elements.size(), assemblyThreads, [&](size_t begin, size_t end) {
+				for (size_t ePos = begin; ePos < end; ePos++) {
+					const vBeam& element = Elements[ePos];
+					keys[ePos] = Duplicates::ElementKey(element.node1Pos, element.node2Pos, matchSection ? element.getSectionId() : SIZE_MAX);
+				}
+			});
+			if (keys.size() < (1 << 20) || assemblyThreads == 1) return Duplicates::groupKeys(keys);
+			return Duplicates::groupKeysSorted(keys, [&](size_t count, auto func) { parallelFor(count, assemblyThreads, func); });
+		}
+
+		//Removes all but the first element of every group in one compaction. Returns the element position remap of removeElements
+		std::vector<size_t> removeDuplicateElems(const std::vector<std::vector<size_t>>& groups) {
+			std::vector<size_t> toRemove;
+			for (auto& group : groups) toRemove.insert(toRemove.end(), group.begin() + 1, group.end());
+			return removeElements(toRemove);
+		}
+
+		void removeDuplicateElems(bool matchSection = false) {
+			removeDuplicateElems(findDuplicateElements(matchSection));
+		}
+
+		//NO_ELEMENT if the element was removed
+		size_t getElementPos_byId(Eigen::Index id) {
+			flushBatch();
+			if (id < 0 || (size_t)id >= idToSlot.size()) return NO_ELEMENT;
+			return idToSlot[id];
 		}
 
 		void oneElementTest() {
@@ -890,7 +1905,7 @@ namespace Beams {
 
 
 			BCfixed.emplace(0);
-			Forces[4][1] = 100;
+			activeForces()[4][1] = 100;
 
 		};
 
@@ -902,173 +1917,398 @@ namespace Beams {
 		//nodePos is the position containing deleted nodes. 
 		void addForce(size_t nodePos, size_t Dof, double val) {
 			std::array<double,6> ar{ 0,0,0,0,0,0 };
-			auto it = Forces.emplace(std::make_pair(nodePos, ar));
+			auto it = activeForces().emplace(std::make_pair(nodePos, ar));
 			it.first->second[Dof] = val;
 			solved = false;
+			modelEdited();
 
 		}
 
-		void solve() {
+	private:
+
+		void releaseFactorization() {
+			ldlt.reset();
+			cachedFactor.reset();
+			lu.reset();
+			denseLU.reset();
+			factorization = Factorization::None;
+			factorizedRevision = SIZE_MAX;
+			analyzedRevision = SIZE_MAX;
+		}
+
+		//Assembles, reduces and factorizes K. Returns false if no factorization could be made, mechanismReport says why.
+		bool factorize() {
+			factorization = Factorization::None;
+			factorizedRevision = SIZE_MAX;
+			denseLU.reset();
+			cachedFactor.reset();
+			mechanismReport = MechanismReport();
+
+			//only LDLT factors are cached, LU keeps its permutations to itself
+			bool useCache = factorCache.isEnabled() && symmetricSolve;
+			uint64_t cacheKey = useCache ? getStiffnessHash() : 0;
+			if (useCache && loadCachedFactor(cacheKey)) {
+				std::cout << "Stiffness found in factor cache - Skipping factorization\n";
+				return true;
+			}
+
+			bool newPattern = analyzedRevision != patternRevision;
+			if (newPattern) {
+				ldlt.reset();
+				lu.reset();
+			}
+			else std::cout << "Stiffness pattern unchanged - Reusing symbolic analysis\n";
 
 			//----------------------------------------------------------------------------------------------------
-			//Setup 
+			//Setting of node dof positions in stiffness matrix & stiffness pattern. Only redone when the topology changed
 			//----------------------------------------------------------------------------------------------------
-			//TODO: Check for unconstrained model
-			std::vector<Eigen::Triplet<double>> globalK_triplets;//Contains global stiffness matrix triplets
-			
-
-			if (BCfixed.size() + BCpinned.size() < 1) {
-				solved = false;
-				return;
+			updateNumbering();
+			if (!stiffnessPattern.isValid() || stiffnessPattern.isLowerOnly() != symmetricSolve) {
+				stiffnessPattern.build(Elements, Nodes, noDofs, symmetricSolve);
 			}
 
+			if (noDofs < 1) return false;
+			
+			#ifdef DEBUG_PRINTS
+				std::cout << "\n------------------------------------\nNO DOFs: " << noDofs << "\n";
+			#endif // DEBUG_PRINTS
 
 			//----------------------------------------------------------------------------------------------------
-			//Setting of node dof positions in stiffness matrix
+			//Diagnostics: parts of the model that are not held by any BC. Cheap, so it runs before anything is assembled
 			//----------------------------------------------------------------------------------------------------
-			nodesPos_InMatrixOrder.clear();
-			noDofs = 0;
-			std::unordered_set<size_t> included;
-			for (auto& element : Elements) {
-				size_t n1Pos = element.node1Pos;
-				size_t n2Pos = element.node2Pos;
+			buildDofMap();
+			bool supported = checkSupports();
+			if (!supported && !denseFallbackAllowed(dofMap.size())) {
+				printMechanismReport();
+				return false;
+			}
 
 
-				if (included.emplace(n1Pos).second) {
-					Nodes.setMatrixPos_byPos(n1Pos, nodesPos_InMatrixOrder.size());
-					nodesPos_InMatrixOrder.push_back(n1Pos);
-					noDofs += 6;
-				}
+			//----------------------------------------------------------------------------------------------------
+			//Populate global stiffness matrix values from each element
+			//----------------------------------------------------------------------------------------------------
+			stiffnessPattern.assemble(Elements, assemblyThreads);
+			const Eigen::SparseMatrix<double>& globalK = stiffnessPattern.getMatrix();
 
-				if (included.emplace(n2Pos).second) {
-					Nodes.setMatrixPos_byPos(n2Pos, nodesPos_InMatrixOrder.size());
-					nodesPos_InMatrixOrder.push_back(n2Pos);
-					noDofs += 6;
-				}
-			}
+			#ifdef DEBUG_PRINTS
+				std::cout << "\n------------------------------------\n Glob Matrix noRowDeletion:\n " << Eigen::MatrixXd(globalK) << "\n";
+			#endif // DEBUG_PRINTS
 
-			if (noDofs < 1) return;
+			//----------------------------------------------------------------------------------------------------
+			//Stifness Marix Row/Column Elimination from BCs & create Global K Matrix
+			//----------------------------------------------------------------------------------------------------
+			Eigen::SparseMatrix<double> globMatr;
+			dofMap.reduce(globalK, globMatr);
 			
 			#ifdef DEBUG_PRINTS
-				std::cout << "\n------------------------------------\nNO DOFs: " << noDofs << "\n";
+				std::cout << "\n------------------------------------\n Glob Matrix after row elimination\n " << Eigen::MatrixXd(globMatr) << "\n";
 			#endif // DEBUG_PRINTS
-			
+
 
 
 			//----------------------------------------------------------------------------------------------------
-			//Populate global stiffness matrix (triplets) from each element
+			//Factorization
 			//----------------------------------------------------------------------------------------------------
-			#ifdef DEBUG_PRINTS
-				Eigen::SparseMatrix<double> testGlobAll(noDofs, noDofs);
-			#endif
+			factorizedRevision = stiffnessRevision;
+			analyzedRevision = patternRevision;
+			if (globMatr.rows() == 0) return true;//everything constrained, nothing to factorize
+
+			if (supported && symmetricSolve) {
+				//symbolic analysis (elimination tree, column counts) only for a new pattern, numeric factorization every time
+				if (!ldlt) {
+					ldlt.reset(new Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>, Eigen::Lower, Eigen::NaturalOrdering<int>>());
+					ldlt->analyzePattern(globMatr);
+				}
+				ldlt->factorize(globMatr);
+				recordZeroPivots(*ldlt, globMatr);
+
+				if (!mechanismReport.isMechanism()) {
+					std::cout << "Sparse LDLT Decomposition Successful\n";
+					factorization = Factorization::LDLT;
+					if (useCache) factorCache.store(cacheKey, nodesPos_InMatrixOrder, orderingBefore, orderingAfter, ldlt->matrixL().nestedExpression(), ldlt->vectorD());
+					return true;
+				}
+				//the symbolic analysis stays, the next factorization may succeed
+			}
+			else if (supported) {
+				if (!lu) {
+					lu.reset(new Eigen::SparseLU<Eigen::SparseMatrix<double>>());
+					lu->analyzePattern(globMatr);
+				}
+				lu->factorize(globMatr);
 
-			for (auto& element : Elements) {
-				element.LocalMatrix2GlobalTriplets(globalK_triplets, Nodes, Sections[element.getSectionId()]);
+				if (lu->info() == Eigen::Success) {
+					// Decomposition Succesfull
+					std::cout << "Sparse LU Decomposition Successful\n";
+					factorization = Factorization::LU;
+					return true;
+				}
 
-			
+				//LU pivots are permuted and not exposed, the report comes from an LDLT of the same (symmetric) K
+				mechanismReport.solverMessage = "Sparse LU: " + lu->lastErrorMessage();
+				Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>, Eigen::Lower, Eigen::NaturalOrdering<int>> monitor(globMatr);
+				recordZeroPivots(monitor, globMatr);
+			}
 
+			printMechanismReport();
+			if (!denseFallbackAllowed(globMatr.rows())) {
+				factorizedRevision = SIZE_MAX;
+				return false;
 			}
 
-			#ifdef DEBUG_PRINTS
-				testGlobAll.setFromTriplets(globalK_triplets.begin(), globalK_triplets.end());
-				std::cout << "\n------------------------------------\n Glob Matrix noRowDeletion:\n " << Eigen::MatrixXd(testGlobAll) << "\n";
-			#endif // DEBUG_PRINTS
+			std::cout << "Dense LU fallback (" << globMatr.rows() << " equations)\n";
+			if (symmetricSolve) {
+				Eigen::SparseMatrix<double> fullMatr = globMatr.selfadjointView<Eigen::Lower>();
+				globMatr.swap(fullMatr);
+			}
+			denseLU.reset(new Eigen::PartialPivLU<Eigen::MatrixXd>(Eigen::MatrixXd(globMatr)));
+			factorization = Factorization::DenseLU;
+			return true;
+		}
 
-			size_t noDofsUsed = noDofs- 6 * (BCfixed.size()) - 3 * BCpinned.size();
-			Eigen::SparseMatrix<double> globMatr(noDofsUsed, noDofsUsed);
+		//Numbering and LDLT factor from the factor cache. False if there is no usable factor for key, the model is unchanged then.
+		bool loadCachedFactor(uint64_t key) {
+			std::unique_ptr<CachedFactor> factor(new CachedFactor());
+			if (!factorCache.load(key, *factor)) return false;
 
+			//the cached numbering has to hold every element end node once, anything else is a hash collision
+			size_t noPositions = 0;
+			for (auto& element : Elements) noPositions = std::max(noPositions, std::max(element.node1Pos, element.node2Pos) + 1);
+			std::vector<uint8_t> endNode(noPositions, 0);
+			size_t noEndNodes = 0;
+			for (auto& element : Elements) {
+				for (size_t pos : { element.node1Pos, element.node2Pos }) {
+					if (!endNode[pos]) noEndNodes++;
+					endNode[pos] = 1;
+				}
+			}
+			if (factor->nodeOrder.size() != noEndNodes) return false;
+			for (size_t pos : factor->nodeOrder) {
+				if (pos >= noPositions || endNode[pos] != 1) return false;
+				endNode[pos] = 2;
+			}
 
+			//a different numbering outdates everything that was built on the current one
+			if (!nodesNumbered || nodesPos_InMatrixOrder != factor->nodeOrder) {
+				nodesPos_InMatrixOrder = factor->nodeOrder;
+				for (size_t m = 0; m < nodesPos_InMatrixOrder.size(); m++) Nodes.setMatrixPos_byPos(nodesPos_InMatrixOrder[m], m);
+				noDofs = 6 * nodesPos_InMatrixOrder.size();
+				nodesNumbered = true;
+				stiffnessPattern.invalidate();
+				ldlt.reset();
+				lu.reset();
+				analyzedRevision = SIZE_MAX;
+				operatorRevision = SIZE_MAX;
+				resultsRevision = SIZE_MAX;
+			}
+			orderingBefore = factor->orderingBefore;
+			orderingAfter = factor->orderingAfter;
 
-			//----------------------------------------------------------------------------------------------------
-			//Stifness Marix Row/Column Elimination from BCs & create Global K Matrix
-			//----------------------------------------------------------------------------------------------------
-			//TODO: Better solution without triplet duplication. (faster?)
-			
-			std::vector<Eigen::Triplet<double>> triplets_AfterBCs;
-			std::vector<Eigen::Triplet<double>> triplets_AfterBCsALL;
-			int row, col, val;
-			int minusRow, minusCol;
-			
+			buildDofMap();
+			if (!checkSupports() || factor->L.rows() != (Eigen::Index)dofMap.size()) {
+				mechanismReport = MechanismReport();
+				return false;
+			}
+			cachedFactor.swap(factor);
+			factorization = Factorization::CachedLDLT;
+			factorizedRevision = stiffnessRevision;
+			return true;
+		}
 
-			for (auto& triplet : globalK_triplets) {
-				row = triplet.row(); col = triplet.col(); val = triplet.value();
-				minusRow = 0; minusCol = 0; 
-				bool isInBC = false;
+		//Forward/back substitution with an LDLT factor for all columns at once: L is traversed once per sweep
+		//and every entry updates a whole (contiguous) row of right hand sides. L is unit lower, its diagonal not stored.
+		static void solveLDLT(const Eigen::SparseMatrix<double>& L, const Eigen::VectorXd& D, Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>& X) {
+			Eigen::Index n = L.cols();
 
-				for (size_t fixBCid : BCfixed) {
-					size_t BCstart = Nodes.get_byPos(fixBCid).matrixPos * 6;
-					size_t BCend = Nodes.get_byPos(fixBCid).matrixPos * 6 + 5;
-					const static size_t BCdofs = 6;
+			for (Eigen::Index j = 0; j < n; j++) {
+				for (Eigen::SparseMatrix<double>::InnerIterator it(L, j); it; ++it) {
+					if (it.row() > j) X.row(it.row()) -= it.value() * X.row(j);
+				}
+			}
+			for (Eigen::Index j = 0; j < n; j++) X.row(j) /= D(j);
+			for (Eigen::Index j = n - 1; j >= 0; j--) {
+				for (Eigen::SparseMatrix<double>::InnerIterator it(L, j); it; ++it) {
+					if (it.row() > j) X.row(j) -= it.value() * X.row(it.row());
+				}
+			}
+		}
 
-					if (row > BCend) minusRow += BCdofs;//if after BC, row is BC dofs less.(row elimination.)
-					else if(row >= BCstart){ //not after BC end dof but after BC start dof means in BC dofs
-						isInBC = true;
-						break; // go to next, no matter the column
-					}
+		//Dof map, element operator and preconditioner for PCG. Each part is only rebuilt when what it depends on changed.
+		bool prepareIterative() {
+			updateNumbering();
+			if (noDofs < 1) return false;
+
+			if (operatorRevision != patternRevision) {
+				buildDofMap();
+				mechanismReport = MechanismReport();
+				if (!checkSupports()) {
+					printMechanismReport();
+					return false;
+				}
+				elementOperator.build(Elements, Nodes, dofMap);
+				operatorRevision = patternRevision;
+				preconditionedRevision = SIZE_MAX;
+			}
+			if (preconditionedRevision == stiffnessRevision) return true;
+
+			builtPreconditioner = pcgSettings.preconditioner;
+			if (builtPreconditioner == Preconditioner::IC0) {
+				if (!stiffnessPattern.isValid() || !stiffnessPattern.isLowerOnly()) stiffnessPattern.build(Elements, Nodes, noDofs, true);
+				stiffnessPattern.assemble(Elements, assemblyThreads);
+				Eigen::SparseMatrix<double> lower;
+				dofMap.reduce(stiffnessPattern.getMatrix(), lower);
+				if (ic0.compute(lower)) {
+					if (ic0.getShift() > 0) std::cout << "IC(0) needed a diagonal shift of " << ic0.getShift() << "\n";
+				}
+				else {
+					std::cout << "IC(0) broke down - Using block Jacobi\n";
+					builtPreconditioner = Preconditioner::BlockJacobi;
+				}
+			}
+			if (builtPreconditioner == Preconditioner::BlockJacobi) {
+				std::vector<Eigen::Matrix<double, 6, 6>> blocks;
+				elementOperator.nodeBlocks(Elements, nodesPos_InMatrixOrder.size(), blocks, assemblyThreads);
+				std::vector<Eigen::Index> nodeEqs(noDofs);
+				for (size_t dof = 0; dof < noDofs; dof++) nodeEqs[dof] = dofMap[dof];
+				blockJacobi.compute(blocks, std::move(nodeEqs));
+			}
+			preconditionedRevision = stiffnessRevision;
+			return true;
+		}
 
-					if (col > BCend) minusCol+= BCdofs;
-					else if (col >= BCstart) {
-						isInBC = true;
-						break;
-					}
-					
+		//PCG per load case. Starts from the previous result of the case when the numbering is unchanged.
+		void solveIterative(const Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>& rhs) {
+			Eigen::MatrixXd results(rhs.rows(), rhs.cols());
+			bool canWarmStart = pcgSettings.warmStart && resultsRevision == patternRevision && caseResults.rows() == rhs.rows();
+			auto applyK = [&](const Eigen::VectorXd& x, Eigen::VectorXd& y) {
+				elementOperator.apply(Elements, x, y, assemblyThreads);
+			};
+			auto applyM = [&](const Eigen::VectorXd& r, Eigen::VectorXd& z) {
+				switch (builtPreconditioner) {
+				case Preconditioner::BlockJacobi: blockJacobi.apply(r, z); break;
+				case Preconditioner::IC0: ic0.apply(r, z); break;
+				default: z = r;
 				}
-				if(!isInBC) triplets_AfterBCs.emplace_back(row-minusRow, col-minusCol, val);
-			
-			//#ifdef DEBUG_PRINTS
-				if (isInBC) val = -101;
-				triplets_AfterBCsALL.emplace_back(row, col, val);
-			//#endif // DEBUG_PRINTS
-			
+			};
+
+			std::map<std::string, PCGReport> reports;
+			for (Eigen::Index c = 0; c < rhs.cols(); c++) {
+				const std::string& name = solvedCases[c];
+				Eigen::VectorXd x = Eigen::VectorXd::Zero(rhs.rows());
+				if (canWarmStart) {
+					auto previous = std::find(previousCases.begin(), previousCases.end(), name);
+					if (previous != previousCases.end()) x = caseResults.col(previous - previousCases.begin());
+				}
+				PCGReport report = conjugateGradient(applyK, applyM, Eigen::VectorXd(rhs.col(c)), x, pcgSettings.tolerance, pcgSettings.maxIterations);
+				std::cout << "PCG " << name << ": " << report.iterations << " iterations, relative residual " << report.relativeResidual;
+				std::cout << (report.converged ? "\n" : " - NOT CONVERGED\n");
+				results.col(c) = x;
+				reports[name] = report;
 			}
+			caseResults.swap(results);
+			pcgReports.swap(reports);
+		}
 
-			globMatr.setFromTriplets(triplets_AfterBCs.begin(), triplets_AfterBCs.end());
-			
-			#ifdef DEBUG_PRINTS
-				Eigen::SparseMatrix<double> asd(noDofs, noDofs);
-				asd.setFromTriplets(triplets_AfterBCsALL.begin(), triplets_AfterBCsALL.end());
-				std::cout << "\n------------------------------------\n Glob Matrix with noted removed Rows/Colsn\n " << Eigen::MatrixXd(asd) << "\n";
-				std::cout << "\n------------------------------------\n Glob Matrix after row elimination\n " << Eigen::MatrixXd(globMatr) << "\n";
-		
-			#endif // DEBUG_PRINTS
-			
+		//Reduced vector (one entry per equation) to all dofs in matrix order, 0 for constrained dofs
+		Eigen::VectorXd expandToDofs(const Eigen::VectorXd& reduced) const {
+			Eigen::VectorXd full = Eigen::VectorXd::Zero(dofMap.noDofs());
+			if (reduced.size() != dofMap.size()) return full;
+			for (size_t dof = 0; dof < dofMap.noDofs(); dof++) {
+				Eigen::Index eq = dofMap[dof];
+				if (eq != DofMap::CONSTRAINED) full(dof) = reduced(eq);
+			}
+			return full;
+		}
 
+		//Loads of a load case or combination on all dofs in matrix order
+		Eigen::VectorXd loadVector(const std::string& name) {
+			Eigen::VectorXd full = Eigen::VectorXd::Zero(dofMap.noDofs());
+			auto addCase = [&](const LoadCase& loadCase, double factor) {
+				for (auto& force : loadCase) {
+					if (!isInMatrix(force.first)) continue;
+					size_t dof = Nodes.get_byPos(force.first).matrixPos * 6;
+					for (int d = 0; d < 6; d++) full(dof + d) += factor * force.second[d];
+				}
+			};
+			auto caseIt = LoadCases.find(name);
+			if (caseIt != LoadCases.end()) addCase(caseIt->second, 1);
+			auto combIt = LoadCombinations.find(name);
+			if (combIt != LoadCombinations.end()) {
+				for (auto& factor : combIt->second) {
+					caseIt = LoadCases.find(factor.first);
+					if (caseIt != LoadCases.end()) addCase(caseIt->second, factor.second);
+				}
+			}
+			return full;
+		}
+
+		//The 12 global end displacements of an element out of a vector over all dofs in matrix order
+		Eigen::Matrix<double, 12, 1> elementDisplacements(const vBeam& element, const Eigen::VectorXd& full) const {
+			Eigen::Matrix<double, 12, 1> u;
+			u.head<6>() = full.segment<6>(6 * Nodes.get_byPos(element.node1Pos).matrixPos);
+			u.tail<6>() = full.segment<6>(6 * Nodes.get_byPos(element.node2Pos).matrixPos);
+			return u;
+		}
+
+		//Sets U/Urender to the displayed load case or combination
+		void updateDisplayedResult() {
+			U = expandToDofs(getResult(displayedResult));
+			size_t noMatrixNodes = U.size() / 6;
+			Urender.resize(noMatrixNodes);
+			double renderScale = RENDER_SCALING_FACTOR * scaleFactor;
+			for (size_t m = 0; m < noMatrixNodes; m++) {
+				Urender[m] = Vector3{ (float)(U(6 * m) * renderScale), (float)(U(6 * m + 1) * renderScale), (float)(U(6 * m + 2) * renderScale) };
+			}
+		}
+
+	public:
+
+		//Solves all load cases. K is only refactorized if something that changes it happened since the last solve.
+		void solve() {
 
 			//----------------------------------------------------------------------------------------------------
-			//F Vector Creation and Row Elimination
+			//Setup 
 			//----------------------------------------------------------------------------------------------------
-			
-			F.resize(globMatr.rows());
-
-			std::vector<Eigen::Triplet<double>> Ftriplets_AfterBCs;
-			//make forces vector 
-			for (auto& force : Forces) {
-				size_t forceMatrixPos = Nodes.get_byPos(force.first).matrixPos*6;
-				bool inBC = false;
-				size_t minusPos = 0;
-				for (size_t BCid : BCfixed) {
-					size_t BCstart = Nodes.get_byPos(BCid).matrixPos*6;
-					size_t BCend = Nodes.get_byPos(BCid).matrixPos*6 + 5;
-					if (forceMatrixPos > BCend) minusPos += 6;
-					else if (forceMatrixPos >= BCstart) {
-						inBC = true;
-						break;
-					}
+			//TODO: Check for unconstrained model
+			flushBatch();
 
-				}
-				forceMatrixPos -= minusPos;
-				if (inBC || forceMatrixPos >= F.rows()) continue;
+			if (BCfixed.size() + BCpinned.size() + BCmasks.size() < 1) {
+				solved = false;
+				return;
+			}
+
+			if (solverMode == SolverMode::Iterative) {
+				if (!prepareIterative()) return;
+			}
+			else if (factorizedRevision != stiffnessRevision) {
+				if (!factorize()) return;
+			}
+			else std::cout << "Stiffness unchanged - Reusing factorization\n";
 
-				F.insert((Eigen::Index)forceMatrixPos) = force.second[0];
-				F.insert((Eigen::Index)forceMatrixPos + 1) = force.second[1];
-				F.insert((Eigen::Index)forceMatrixPos + 2) = force.second[2];
-				F.insert((Eigen::Index)forceMatrixPos + 3) = force.second[3];
-				F.insert((Eigen::Index)forceMatrixPos + 4) = force.second[4];
-				F.insert((Eigen::Index)forceMatrixPos + 5) = force.second[5];
 
+
+			//----------------------------------------------------------------------------------------------------
+			//F Vectors (one column per load case) Creation and Row Elimination
+			//----------------------------------------------------------------------------------------------------
+			Eigen::Index noEquations = dofMap.size();
+			Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> rhs = Eigen::MatrixXd::Zero(noEquations, LoadCases.size());
+			previousCases.swap(solvedCases);
+			solvedCases.clear();
+
+			for (auto& loadCase : LoadCases) {
+				Eigen::Index caseCol = solvedCases.size();
+				solvedCases.push_back(loadCase.first);
+				for (auto& force : loadCase.second) {
+					if (!isInMatrix(force.first)) continue;
+					size_t forceMatrixPos = Nodes.get_byPos(force.first).matrixPos*6;
+					for (int d = 0; d < 6; d++) {
+						Eigen::Index eq = dofMap[forceMatrixPos + d];
+						if (eq != DofMap::CONSTRAINED) rhs(eq, caseCol) += force.second[d];
+					}
+				}
 			}
 			#ifdef DEBUG_PRINTS
-				std::cout << "\n--------------------------------\nForce Vector\n" << F << "\n";
+				std::cout << "\n--------------------------------\nForce Vectors\n" << rhs << "\n";
 			#endif // DEBUG_PRINTS
 
 
@@ -1076,43 +2316,40 @@ namespace Beams {
 			//----------------------------------------------------------------------------------------------------
 			//Solving
 			//----------------------------------------------------------------------------------------------------
-			//TODO: Proper handling of failed solves.
-
-
-
-
-			Eigen::SparseLU<Eigen::SparseMatrix<double>> solver;
-			solver.compute(globMatr);
-			
-			if (solver.info() == Eigen::Success) {
-				// Decomposition Succesfull
-				std::cout << "Sparse LU Decomposition Successful\n";
-				U = solver.solve(F);
-				if (solver.info() != Eigen::Success) {
+			if (solverMode == SolverMode::Iterative) solveIterative(rhs);
+			else switch (factorization) {
+			case Factorization::LDLT:
+				solveLDLT(ldlt->matrixL().nestedExpression(), ldlt->vectorD(), rhs);
+				caseResults = rhs;
+				break;
+			case Factorization::CachedLDLT:
+				solveLDLT(cachedFactor->L, cachedFactor->D, rhs);
+				caseResults = rhs;
+				break;
+			case Factorization::LU:
+				caseResults = lu->solve(Eigen::MatrixXd(rhs));
+				if (lu->info() != Eigen::Success) {
 					// solving failed
 					std::cout << "solving failed - Exiting";
 					return;
 				}
-				std::cout << "Sparse Solving Successful\n";
-				solved = true;
-				//std::cout << U;
-				Urender = U * RENDER_SCALING_FACTOR * scaleFactor;
-#ifdef DEBUG_PRINTS
-				//std::cout << "\n--------------------------------\nForce Vector\n" << Eigen::VectorXd(F) << "\n";
-				//std::cout << "\n--------------------------------\Deflection Vector\n" << Eigen::VectorXd(U) << "\n";
-
-#endif // DEBUG_PRINTS
-				return;
+				break;
+			case Factorization::DenseLU:
+				caseResults.resize(noEquations, rhs.cols());
+				for (Eigen::Index c = 0; c < rhs.cols(); c++) caseResults.col(c) = denseLU->solve(Eigen::VectorXd(rhs.col(c)));
+				break;
+			default: //everything constrained
+				caseResults = Eigen::MatrixXd::Zero(noEquations, rhs.cols());
 			}
+			std::cout << "Sparse Solving Successful (" << solvedCases.size() << " load cases)\n";
+			resultsRevision = patternRevision;
 
-			std::cout << "Sparse LU decomposition failed\nConverting to Dense\n";
-			Eigen::MatrixXd A(globMatr);// DO EXCEPTION HERE if this fails Also
-			U = A.lu().solve(Eigen::VectorXd(F)).sparseView();
-			//std::cout << F << "\n" << A << "\n" << U;
-			Urender.resize(U.rows());
-			Urender = U * RENDER_SCALING_FACTOR * scaleFactor;
+			F = loadVector(activeLoadCase); //rhs holds the displacements by now
 			solved = true;
-
+			updateDisplayedResult();
+#ifdef DEBUG_PRINTS
+			//std::cout << "\n--------------------------------\Deflection Vector\n" << Eigen::VectorXd(U) << "\n";
+#endif // DEBUG_PRINTS
 		}
 
 		const NodeContainer& getNodes() {
@@ -1120,73 +2357,211 @@ namespace Beams {
 		}
 
 		const std::vector<vBeam>& getElements() {
+			flushBatch();
 			return Elements;
 		}
 
 		Vector3 getDeflection(size_t nodeMatrixPos) {
-			if (!solved) return Vector3Zero();
+			if (!solved || nodeMatrixPos >= Urender.size()) return Vector3Zero(); //Free node, not in Stifness matrix
+			const double* u = U.data() + 6 * nodeMatrixPos;
+			return Vector3{ (float)u[0], (float)u[1], (float)u[2] };
+		}
 
-			size_t fixedNodesBefore = 0;
-			for (size_t fixedId : BCfixed) {
-				size_t BCmatrixPos = Nodes.get_byPos(fixedId).matrixPos;
-				if (BCmatrixPos < nodeMatrixPos) fixedNodesBefore++;
-				else if (BCmatrixPos == nodeMatrixPos) return Vector3Zero();
-			}
-			size_t afterBcId = nodeMatrixPos * 6 - fixedNodesBefore * 6;
-			if (afterBcId >= U.rows()) return Vector3Zero(); //Free node, not in Stifness matrix
+		//All 6 dofs (translations, rotations) of the displayed result
+		std::array<double, 6> getNodeDisplacements(size_t nodeMatrixPos) {
+			std::array<double, 6> u{ 0,0,0,0,0,0 };
+			if (!solved || nodeMatrixPos >= Urender.size()) return u;
+			std::copy(U.data() + 6 * nodeMatrixPos, U.data() + 6 * nodeMatrixPos + 6, u.begin());
+			return u;
+		}
 
+		Vector3 getDeflectionRender(size_t nodeMatrixPos) {//doesn't give rotations. Nodes in the matrix are never free while solved
+			if (!solved || nodeMatrixPos >= Urender.size()) return Vector3Zero();//not in stifness matrix
+			return Urender[nodeMatrixPos];
+		}
 
-			return Vector3{ (float)U.coeff(afterBcId),(float)U.coeff(afterBcId + 1),(float)U.coeff(afterBcId + 2) };
+		Vector3 getForce(size_t nodePos) {
+			const LoadCase& Forces = activeForces();
+			auto it = Forces.find(nodePos);
 
+			if (it == Forces.end()) return Vector3Zero();
+			return Vector3{ (float)it->second[0],(float)it->second[1],(float)it->second[2] };
 		}
 
-		Vector3 getDeflectionRender(size_t nodeMatrixPos) {//doesn't give rotations. 
-			if (!solved) return Vector3Zero();
+		void removeForce(size_t nodePos) {
+			activeForces().erase(nodePos);
+			solved = false;
+			modelEdited();
 
-			if (nodeMatrixPos >= nodesPos_InMatrixOrder.size()) return Vector3Zero();//not in stifness matrix
-			const Node& node = Nodes.get_byPos(nodesPos_InMatrixOrder[nodeMatrixPos]);
+		}
 
-			if (node.free_flag) return Vector3Zero();
+		const LoadCase& getForces() const  {
+			return LoadCases.at(activeLoadCase);
+		}
 
-			size_t fixedNodesBefore = 0;
-			for (size_t fixedId : BCfixed) {
-				size_t BCmatrixPos = Nodes.get_byPos(fixedId).matrixPos;
-				if (BCmatrixPos < nodeMatrixPos) fixedNodesBefore++;
-				else if (BCmatrixPos == nodeMatrixPos) return Vector3Zero();
-			}
+		//Load cases. addForce/removeForce/getForces work on the active one. The default case always exists.
+		void setActiveLoadCase(const std::string& name) {
+			LoadCases[name];
+			activeLoadCase = name;
+		}
+
+		const std::string& getActiveLoadCase() const {
+			return activeLoadCase;
+		}
 
-			size_t afterBcId = nodeMatrixPos * 6 - fixedNodesBefore * 6;
+		void removeLoadCase(const std::string& name) {
+			if (name == DEFAULT_LOADCASE) return;
+			if (LoadCases.erase(name)) solved = false;
+			if (activeLoadCase == name) activeLoadCase = DEFAULT_LOADCASE;
+		}
 
-			return Vector3{ (float)Urender.coeff(afterBcId) ,(float)Urender.coeff(afterBcId + 1) ,(float)Urender.coeff(afterBcId + 2) };
+		const std::map<std::string, LoadCase>& getLoadCases() const {
+			return LoadCases;
+		}
 
+		//Linear combination of load case results. Unknown case names contribute nothing.
+		void addLoadCombination(const std::string& name, const LoadCombination& factors) {
+			if (LoadCases.count(name)) return; //names are shared with the load cases
+			LoadCombinations[name] = factors;
+			solved = false;
 		}
 
-		Vector3 getForce(size_t nodePos) {
-			auto it = Forces.find(nodePos);
+		void removeLoadCombination(const std::string& name) {
+			if (LoadCombinations.erase(name)) solved = false;
+			if (displayedResult == name) displayedResult = DEFAULT_LOADCASE;
+		}
 
-			if (it == Forces.end()) return Vector3Zero();
-			return Vector3{ (float)it->second[0],(float)it->second[1],(float)it->second[2] };
+		const std::map<std::string, LoadCombination>& getLoadCombinations() const {
+			return LoadCombinations;
 		}
 
-		void removeForce(size_t nodePos) {
-			auto it = Forces.erase(nodePos);
-			solved = false;
+		//Load case or combination whose result getDeflection/getDeflectionRender return
+		void setDisplayedResult(const std::string& name) {
+			if (!LoadCases.count(name) && !LoadCombinations.count(name)) return;
+			displayedResult = name;
+			if (solved) updateDisplayedResult();
+		}
 
+		const std::string& getDisplayedResult() const {
+			return displayedResult;
+		}
+
+		//Reduced displacements of a load case or combination, empty if not solved/unknown
+		Eigen::VectorXd getResult(const std::string& name) const {
+			if (!solved) return Eigen::VectorXd();
+			auto caseIt = std::find(solvedCases.begin(), solvedCases.end(), name);
+			if (caseIt != solvedCases.end()) return caseResults.col(caseIt - solvedCases.begin());
+
+			auto combIt = LoadCombinations.find(name);
+			if (combIt == LoadCombinations.end()) return Eigen::VectorXd();
+			Eigen::VectorXd result = Eigen::VectorXd::Zero(caseResults.rows());
+			for (auto& factor : combIt->second) {
+				caseIt = std::find(solvedCases.begin(), solvedCases.end(), factor.first);
+				if (caseIt != solvedCases.end()) result += factor.second * caseResults.col(caseIt - solvedCases.begin());
+			}
+			return result;
 		}
 
-		const std::map<size_t, std::array<double, 6>>& getForces() const  {
-			return Forces;
+		//Displacements of a load case or combination on all dofs in matrix order (6 per node at 6*matrixPos), empty if not solved/unknown
+		Eigen::VectorXd getDisplacements(const std::string& name) const {
+			if (!solved || (!LoadCases.count(name) && !LoadCombinations.count(name))) return Eigen::VectorXd();
+			return expandToDofs(getResult(name));
+		}
+
+		//Support reactions K*U - F of a load case or combination, same layout as getDisplacements. 0 on free dofs.
+		Eigen::VectorXd getReactions(const std::string& name) {
+			Eigen::VectorXd u = getDisplacements(name);
+			if (u.size() == 0) return u;
+			std::vector<Eigen::Matrix<double, 12, 1>> elementForces(Elements.size());
+			parallelFor(Elements.size(), assemblyThreads, [&](size_t begin, size_t end) {
+				for (size_t e = begin; e < end; e++) {
+					elementForces[e].setZero();
+					Elements[e].applyGlobalStiffness(elementDisplacements(Elements[e], u), elementForces[e]);
+				}
+			});
+			Eigen::VectorXd reactions = -loadVector(name);
+			for (size_t e = 0; e < Elements.size(); e++) {
+				reactions.segment<6>(6 * Nodes.get_byPos(Elements[e].node1Pos).matrixPos) += elementForces[e].head<6>();
+				reactions.segment<6>(6 * Nodes.get_byPos(Elements[e].node2Pos).matrixPos) += elementForces[e].tail<6>();
+			}
+			for (size_t dof = 0; dof < dofMap.noDofs(); dof++) {
+				if (dofMap[dof] != DofMap::CONSTRAINED) reactions(dof) = 0;
+			}
+			return reactions;
+		}
+
+		//Local end forces of every element for a load case or combination, one column of 12 per element (node 1 then node 2,
+		//forces then moments). Empty if not solved/unknown.
+		Eigen::MatrixXd getElementEndForces(const std::string& name) {
+			Eigen::VectorXd u = getDisplacements(name);
+			if (u.size() == 0) return Eigen::MatrixXd();
+			Eigen::MatrixXd forces(12, Elements.size());
+			parallelFor(Elements.size(), assemblyThreads, [&](size_t begin, size_t end) {
+				Eigen::Matrix<double, 12, 1> f;
+				for (size_t e = begin; e < end; e++) {
+					Elements[e].calc_LocalEndForces(elementDisplacements(Elements[e], u), f);
+					forces.col(e) = f;
+				}
+			});
+			return forces;
+		}
+
+		//Load cases of the last solve, in the column order of the results
+		const std::vector<std::string>& getSolvedCases() const {
+			return solvedCases;
+		}
+
+		//Results computed elsewhere (a results file) instead of solve(): displacements(c) gives 6 values per node of cases[c],
+		//nodes in getNodes() order. Every load case of the model has to be given. The nodes are numbered without reordering
+		//and the next solve starts over with a new pattern, since there is no factorization behind these results.
+		template <typename CaseDisplacements>
+		bool setResults(const std::vector<std::string>& cases, CaseDisplacements displacements) {
+			if (inBatch() || cases.size() != LoadCases.size()) return false;
+			for (auto& name : cases) {
+				if (!LoadCases.count(name)) return false;
+			}
+			flushBatch();
+			if (BCfixed.size() + BCpinned.size() + BCmasks.size() < 1) return false;
+
+			patternChanged();
+			numberDofs();
+			nodesNumbered = false;
+			stiffnessPattern.invalidate();
+			buildDofMap();
+
+			caseResults.resize(dofMap.size(), cases.size());
+			for (size_t c = 0; c < cases.size(); c++) {
+				const double* values = displacements(c);
+				size_t k = 0;
+				for (auto& node : Nodes) {
+					if (isInMatrix(node.pos)) {
+						for (int d = 0; d < 6; d++) {
+							Eigen::Index eq = dofMap[6 * node.matrixPos + d];
+							if (eq != DofMap::CONSTRAINED) caseResults(eq, c) = values[6 * k + d];
+						}
+					}
+					k++;
+				}
+			}
+			solvedCases = cases;
+			previousCases.clear();
+			resultsRevision = SIZE_MAX; //no warm start from a numbering the next solve replaces
+
+			F = loadVector(activeLoadCase);
+			solved = true;
+			updateDisplayedResult();
+			return true;
 		}
 
 		void addBCfixed(size_t nodePos) {
-			solved = false;
+			patternChanged();
 			if (Nodes.get_byPos(nodePos).free_flag) return;
 			BCfixed.emplace(nodePos);
 		}
 
 		void removeBCfixed(size_t nodePos) {
 			BCfixed.erase(nodePos);
-			solved = false;
+			patternChanged();
 
 		}
 
@@ -1194,6 +2569,42 @@ namespace Beams {
 			return BCfixed;
 		}
 
+		void addBCpinned(size_t nodePos) {
+			patternChanged();
+			if (Nodes.get_byPos(nodePos).free_flag) return;
+			BCpinned.emplace(nodePos);
+		}
+
+		void removeBCpinned(size_t nodePos) {
+			BCpinned.erase(nodePos);
+			patternChanged();
+		}
+
+		const std::set<size_t>& getBCpinned() {
+			return BCpinned;
+		}
+
+		//Constrains the dofs set in mask (see DofMask) on top of any fixed/pinned BC of the node. mask 0 removes it.
+		void addBCmask(size_t nodePos, uint8_t mask) {
+			patternChanged();
+			mask &= DOF_ALL;
+			if (!mask) {
+				BCmasks.erase(nodePos);
+				return;
+			}
+			if (Nodes.get_byPos(nodePos).free_flag) return;
+			BCmasks[nodePos] = mask;
+		}
+
+		void removeBCmask(size_t nodePos) {
+			BCmasks.erase(nodePos);
+			patternChanged();
+		}
+
+		const std::map<size_t, uint8_t>& getBCmasks() {
+			return BCmasks;
+		}
+
 		void printDeformed() {
 			for (auto& node : Nodes) {
 			
@@ -1209,26 +2620,161 @@ namespace Beams {
 		}
 
 		void printU() {
-			std::cout << Eigen::VectorXd{ U } << "\n";
+			std::cout << U << "\n";
 		}
 
 		void printF() {
-			std::cout << Eigen::VectorXd{ F } << "\n";
+			std::cout << F << "\n";
 		}
 
 		bool isSolved() {
 			return solved;
 		}
 
+		//Threads used for stiffness assembly. 0 uses all cores, 1 assembles serially. Results do not depend on it.
+		void setAssemblyThreads(unsigned noThreads) {
+			assemblyThreads = noThreads;
+		}
+
+		unsigned getAssemblyThreads() const {
+			return assemblyThreads;
+		}
+
+		//Symmetric mode stores only the lower triangle of K and factorizes with LDLT. A pivot that is not positive is reported as a
+		//mechanism (getMechanismReport) and the solve stops, unless the dense fallback is allowed. Off: full K and LU.
+		void setSymmetricSolve(bool symmetric) {
+			if (symmetric != symmetricSolve) patternChanged();
+			symmetricSolve = symmetric;
+		}
+
+		bool getSymmetricSolve() const {
+			return symmetricSolve;
+		}
+
+		//Node renumbering before the stiffness matrix is built. The LDLT path factorizes in this order,
+		//so None keeps the element order and gives no fill reduction.
+		void setNodeOrdering(NodeOrdering ordering) {
+			if (ordering == nodeOrdering) return;
+			nodeOrdering = ordering;
+			stiffnessPattern.invalidate();
+			nodesNumbered = false;
+			patternChanged();
+		}
+
+		NodeOrdering getNodeOrdering() const {
+			return nodeOrdering;
+		}
+
+		//Dense LU on a singular K gives no meaningful result, it is only kept to inspect small mechanisms.
+		//Off by default, when on it is used up to maxEquations free dofs.
+		void setDenseFallback(bool allow, size_t maxEquations = 600) {
+			allowDenseFallback = allow;
+			denseFallbackMaxEquations = maxEquations;
+		}
+
+		bool getDenseFallback() const {
+			return allowDenseFallback;
+		}
+
+		//Unsupported parts and dofs without stiffness found by the last solve
+		const MechanismReport& getMechanismReport() const {
+			return mechanismReport;
+		}
+
+		//Direct factorization or PCG applied element by element. Results of both are kept in the same place.
+		void setSolverMode(SolverMode mode) {
+			if (mode == solverMode) return;
+			solverMode = mode;
+			solved = false;
+		}
+
+		SolverMode getSolverMode() const {
+			return solverMode;
+		}
+
+		void setPCGSettings(const PCGSettings& settings) {
+			if (settings.preconditioner != pcgSettings.preconditioner) preconditionedRevision = SIZE_MAX;
+			pcgSettings = settings;
+			if (solverMode == SolverMode::Iterative) solved = false;
+		}
+
+		const PCGSettings& getPCGSettings() const {
+			return pcgSettings;
+		}
+
+		//Iterations and residuals of the last iterative solve, per load case
+		const std::map<std::string, PCGReport>& getPCGReports() const {
+			return pcgReports;
+		}
+
+		//Node block bandwidth/profile/fill of the current numbering before and after reordering
+		const OrderingStats& getOrderingStatsBefore() const {
+			return orderingBefore;
+		}
+
+		const OrderingStats& getOrderingStatsAfter() const {
+			return orderingAfter;
+		}
+
 		const std::map<size_t,Section>& getSections() {
 			return Sections;
 		}
 
+		const StiffnessCacheStats& getStiffnessCacheStats() const {
+			return stiffnessCache.getStats();
+		}
+
+		//Keeps LDLT factors in directory, keyed by getStiffnessHash(), so a later session with the same K skips the factorization.
+		//Least recently used factors are removed above maxBytes. An empty directory turns it off (the default).
+		void setFactorCache(const std::string& directory, uintmax_t maxBytes = (uintmax_t)2 << 30) {
+			factorCache.configure(directory, maxBytes);
+		}
+
+		const FactorCacheStats& getFactorCacheStats() const {
+			return factorCache.getStats();
+		}
+
+		//Hash of everything the reduced K depends on: element connectivity, end & orientation node coordinates, sections, BCs and
+		//the solver settings that change the factor. Node positions are part of it, the cached numbering refers to them.
+		uint64_t getStiffnessHash() {
+			flushBatch();
+			StableHash hash;
+			hash.add((uint64_t)symmetricSolve);
+			hash.add((uint64_t)nodeOrdering);
+			hash.add((uint64_t)Elements.size());
+			for (auto& element : Elements) {
+				for (size_t pos : { element.node1Pos, element.node2Pos, element.node3Pos }) {
+					const Node& node = Nodes.get_byPos(pos);
+					hash.add((uint64_t)pos);
+					hash.add(node.x);
+					hash.add(node.y);
+					hash.add(node.z);
+				}
+				hash.add((uint64_t)element.getSectionId());
+			}
+			hash.add((uint64_t)Sections.size());
+			for (auto& secPair : Sections) {
+				const Section& sec = secPair.second;
+				hash.add((uint64_t)secPair.first);
+				for (double value : { sec.Area, sec.Modulus, sec.G, sec.Ixx, sec.Iyy, sec.Izz }) hash.add(value);
+			}
+			hash.add((uint64_t)BCfixed.size());
+			for (size_t pos : BCfixed) hash.add((uint64_t)pos);
+			hash.add((uint64_t)BCpinned.size());
+			for (size_t pos : BCpinned) hash.add((uint64_t)pos);
+			hash.add((uint64_t)BCmasks.size());
+			for (auto& bc : BCmasks) {
+				hash.add((uint64_t)bc.first);
+				hash.add((uint64_t)bc.second);
+			}
+			return hash.value();
+		}
+
 		void modifySection(const size_t Id, double _Area, double _Modulus, double _G, double _Ixx, double _Iyy, double _Izz) {
 			auto it = Sections.find(Id);
 
 			if (it != Sections.end()) {
-				solved = false;
+				stiffnessChanged();
 				Section& sec = it->second;
 				
 				sec.Area = _Area;
@@ -1238,45 +2784,56 @@ namespace Beams {
 				sec.Modulus = _Modulus;
 				sec.G = _G;
 
-				sec.EIz12 = 12 * _Modulus * _Izz;
-				sec.EIy12 = 12 * _Modulus * _Iyy;
-				sec.EIz6 = 6 * _Modulus * _Izz;
-				sec.EIy6 = 6 * _Modulus * _Iyy;
-				sec.EIz4 = 4 * _Modulus * _Izz;
-				sec.EIy4 = 4 * _Modulus * _Iyy;
-				sec.EIz2 = 2 * _Modulus * _Izz;
-				sec.EIy2 = 2 * _Modulus * _Iyy;
-				for (auto& element : Elements) {
-					if (std::find(sec.inElements.begin(), sec.inElements.end(), element.getID()) != sec.inElements.end()) {
-						element.reCalc(Nodes, sec);
-					}
-				}
+				sec.EIz12 = 12 * sec.Modulus * sec.Izz;
+				sec.EIy12 = 12 * sec.Modulus * sec.Iyy;
+				sec.EIz6 = 6 * sec.Modulus * sec.Izz;
+				sec.EIy6 = 6 * sec.Modulus * sec.Iyy;
+				sec.EIz4 = 4 * sec.Modulus * sec.Izz;
+				sec.EIy4 = 4 * sec.Modulus * sec.Iyy;
+				sec.EIz2 = 2 * sec.Modulus * sec.Izz;
+				sec.EIy2 = 2 * sec.Modulus * sec.Iyy;
+				if (batchDepth) editedSections.insert(Id);
+				else stiffnessCache.updateSection(Id, sec, assemblyThreads);
 			}
 		}
 	
 		void clear() {
-			U.data().clear();
-			F.data().clear();
+			U.resize(0);
+			F.resize(0);
 
 
 			Nodes.clear();
+			nodeAdjacency.invalidate();
 
 			Sections.clear();
 			secIdNext = 0;
 
 			Elements.clear();
 			eId_Last = 0;
+			idToSlot.clear();
+			pendingElements.clear();
+			editedSections.clear();
+			stiffnessCache.clear();
 
 			nodesPos_InMatrixOrder.clear();
 
-			BCpinned.clear();//UNUSED- and going to be unused.
+			BCpinned.clear();
 			BCfixed.clear();
-			Forces.clear();//node position to force. Position refers to All nodes, taking into account the deleted stuff.
+			BCmasks.clear();
+			LoadCases.clear();
+			LoadCases[DEFAULT_LOADCASE];
+			LoadCombinations.clear();
+			activeLoadCase = DEFAULT_LOADCASE;
+			displayedResult = DEFAULT_LOADCASE;
 
 			noDofs = 0;
-
-			solved = false;
-			Urender.data().clear();
+			stiffnessPattern.invalidate();
+			nodesNumbered = false;
+			releaseFactorization();
+			patternChanged();
+			solvedCases.clear();
+			caseResults.resize(0, 0);
+			Urender.clear();
 			scaleFactor = 1; 
 		}
 };
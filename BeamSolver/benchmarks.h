@@ -0,0 +1,779 @@
+#pragma once
+#include "VBeams.h"
+#include "elementStore.h"
+#include "saveFile.h"
+#include <chrono>
+#include <random>
+
+//Micro-benchmarks for the solver internals. Not part of the viewer, enable RUN_BENCHMARKS in main.cpp to run them.
+//Each one also checks its result against the old code or a reference computation and returns whether that passed.
+namespace Benchmarks {
+
+	//Largest difference accepted between two computations of the same matrix or displacements, relative to their largest
+	//entry. The kernels only reorder the same double operations, so anything past a few hundred ulps is a bug.
+	static const double REL_TOLERANCE = 1e-12;
+
+	static inline double secondsSince(std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	//Prints the outcome of a benchmark's checks and passes it on
+	static inline bool verdict(bool passed) {
+		std::cout << "  checks: " << (passed ? "passed" : "FAILED") << "\n";
+		return passed;
+	}
+
+	//Random elements with a shared section. Node positions are the element positions in the container.
+	static inline void makeRandomElements(size_t noElements, Beams::NodeContainer& nodes, std::vector<Beams::vBeam>& elements, const Beams::Section& section, Beams::LocalStiffnessCache& cache) {
+		std::mt19937 gen(42);
+		std::uniform_real_distribution<float> coord(-1000.f, 1000.f);
+
+		for (size_t i = 0; i < 3 * noElements; i++) {
+			Vector3 point{ coord(gen), coord(gen), coord(gen) };
+			nodes.emplace(point);
+		}
+
+		elements.reserve(noElements);
+		for (size_t i = 0; i < noElements; i++) {
+			elements.emplace_back((Eigen::Index)i, nodes.get_byPos(3 * i), nodes.get_byPos(3 * i + 1), nodes.get_byPos(3 * i + 2), 0, section, cache);
+		}
+	}
+
+	//Old kernel: 12x12 sparse rotation and local matrices and a general sparse triple product per element.
+	static inline Eigen::SparseMatrix<double> legacyGlobalStiffness(const Eigen::SparseMatrix<double>& localK, const Eigen::SparseMatrix<double>& rotMatrix) {
+		return rotMatrix * localK * rotMatrix.transpose();
+	}
+
+	static inline Eigen::SparseMatrix<double> legacyRotMatrix(const Eigen::Matrix3d& dirCosines) {
+		std::vector<Eigen::Triplet<double>> dirCosineMat_triplets;
+		dirCosineMat_triplets.reserve(36);
+		for (int i = 0; i < 12; i += 3) {
+			for (int r = 0; r < 3; r++) {
+				for (int c = 0; c < 3; c++) dirCosineMat_triplets.emplace_back(r + i, c + i, dirCosines(r, c));
+			}
+		}
+		Eigen::SparseMatrix<double> rotMatrix(12, 12);
+		rotMatrix.setFromTriplets(dirCosineMat_triplets.begin(), dirCosineMat_triplets.end());
+		return rotMatrix;
+	}
+
+	//Compares the old sparse element kernel against the fixed size one on the same elements.
+	bool elementKernels(size_t noElements = 200000) {
+		Beams::Section section(100, 210000, 80000, 1000, 100, 100);
+		Beams::NodeContainer nodes;
+		std::vector<Beams::vBeam> elements;
+		Beams::LocalStiffnessCache cache;
+		makeRandomElements(noElements, nodes, elements, section, cache);
+
+		//the old storage was built once at element creation, so it is not timed
+		std::vector<Eigen::SparseMatrix<double>> legacyLocal, legacyRot;
+		legacyLocal.reserve(noElements);
+		legacyRot.reserve(noElements);
+		for (auto& element : elements) {
+			legacyLocal.push_back(element.getLocalStiffness().sparseView());
+			legacyRot.push_back(legacyRotMatrix(element.getDirCosines()));
+		}
+
+		double checksumLegacy = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < noElements; i++) {
+			Eigen::SparseMatrix<double> globalB = legacyGlobalStiffness(legacyLocal[i], legacyRot[i]);
+			checksumLegacy += globalB.coeff(1, 1);
+		}
+		double legacyTime = secondsSince(start);
+
+		double checksumNew = 0;
+		Beams::Matrix12d globalB;
+		start = std::chrono::steady_clock::now();
+		for (auto& element : elements) {
+			element.calc_GlobalStiffness(globalB);
+			checksumNew += globalB(1, 1);
+		}
+		double newTime = secondsSince(start);
+
+		double maxRelDiff = 0;
+		for (size_t i = 0; i < noElements; i++) {
+			elements[i].calc_GlobalStiffness(globalB);
+			Eigen::MatrixXd legacy(legacyGlobalStiffness(legacyLocal[i], legacyRot[i]));
+			maxRelDiff = std::max(maxRelDiff, (legacy - globalB).cwiseAbs().maxCoeff() / globalB.cwiseAbs().maxCoeff());
+		}
+
+		std::cout << "Element kernel benchmark (" << noElements << " elements)\n";
+		std::cout << "  sparse R*K*R^T : " << legacyTime << " s (checksum " << checksumLegacy << ")\n";
+		std::cout << "  3x3 block 12x12: " << newTime << " s (checksum " << checksumNew << ")\n";
+		std::cout << "  speedup        : " << legacyTime / newTime << "x\n";
+		std::cout << "  max rel. diff  : " << maxRelDiff << "\n";
+		return verdict(maxRelDiff <= REL_TOLERANCE);
+	}
+
+	//Lines of elements copied onto themselves (like copyElements with a zero offset), with coordinate noise below the tolerance.
+	//Compares the spatial hash against the old std::set search and times the merge. Both have to find every copy.
+	bool duplicateNodes(size_t noNodes = 1000000) {
+		std::mt19937 gen(7);
+		std::uniform_real_distribution<double> noise(-0.3 * ERR_TOLERANCE, 0.3 * ERR_TOLERANCE);
+		Beams::Model model;
+		model.addSection(100, 210000, 80000, 1000, 100, 100);
+		size_t noUnique = noNodes / 2;
+		size_t lineLength = 1000;
+		for (size_t copy = 0; copy < 2; copy++) {
+			for (size_t i = 0; i < noUnique; i++) {
+				float x = (float)(i % lineLength) * 10.f, y = (float)(i / lineLength) * 10.f;
+				model.addNode(Vector3{ x + (float)noise(gen), y + (float)noise(gen), (float)noise(gen) });
+			}
+		}
+		size_t refNode = noNodes;
+		model.addNode(Vector3{ 0, 0, 1000 });
+		for (size_t copy = 0; copy < 2; copy++) {
+			for (size_t i = 0; i + 1 < noUnique; i++) {
+				if ((i + 1) % lineLength) model.addElement(copy * noUnique + i, copy * noUnique + i + 1, refNode, 0);
+			}
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		std::set<Beams::Node> originals;
+		size_t legacyFound = 0;
+		for (auto& node : model.getNodes()) legacyFound += !originals.emplace(node).second;
+		double legacyTime = secondsSince(start);
+
+		start = std::chrono::steady_clock::now();
+		std::unordered_map<size_t, size_t> duplicates = model.findDuplicateNodes();
+		double findTime = secondsSince(start);
+		start = std::chrono::steady_clock::now();
+		model.removeDuplicateNodes(duplicates);
+		double mergeTime = secondsSince(start);
+
+		std::cout << "Duplicate node benchmark (" << noNodes << " nodes, " << noUnique << " duplicated)\n";
+		std::cout << "  std::set search: " << legacyTime << " s, found " << legacyFound << "\n";
+		std::cout << "  spatial hash   : " << findTime << " s, found " << duplicates.size() << "\n";
+		std::cout << "  merge          : " << mergeTime << " s, " << model.getNodes().size() << " nodes left\n";
+		return verdict(legacyFound == noUnique && duplicates.size() == noUnique && model.getNodes().size() == noUnique + 1);
+	}
+
+	//Random node pairs where every 4th element repeats an earlier one, half of them reversed.
+	//Compares the old ordered pair std::map against the hash table and the parallel sort, which must give the same groups.
+	bool duplicateElements(size_t noElements = 1000000) {
+		std::mt19937_64 gen(11);
+		std::uniform_int_distribution<size_t> node(0, noElements);
+		std::vector<std::pair<size_t, size_t>> ends(noElements);
+		for (size_t i = 0; i < noElements; i++) {
+			if (i % 4 == 3) {
+				std::pair<size_t, size_t> earlier = ends[std::uniform_int_distribution<size_t>(0, i - 1)(gen)];
+				ends[i] = (i % 8 == 3) ? std::make_pair(earlier.second, earlier.first) : earlier;
+			}
+			else ends[i] = std::make_pair(node(gen), node(gen));
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		std::map<std::pair<size_t, size_t>, size_t> originals;
+		size_t legacyFound = 0;
+		for (size_t i = 0; i < noElements; i++) legacyFound += !originals.emplace(ends[i], i).second;
+		double legacyTime = secondsSince(start);
+
+		std::vector<Beams::Duplicates::ElementKey> keys(noElements);
+		for (size_t i = 0; i < noElements; i++) keys[i] = Beams::Duplicates::ElementKey(ends[i].first, ends[i].second, SIZE_MAX);
+		start = std::chrono::steady_clock::now();
+		std::vector<std::vector<size_t>> hashGroups = Beams::Duplicates::groupKeys(keys);
+		double hashTime = secondsSince(start);
+		start = std::chrono::steady_clock::now();
+		std::vector<std::vector<size_t>> sortGroups = Beams::Duplicates::groupKeysSorted(keys, [](size_t count, auto func) { Beams::parallelFor(count, 0, func); });
+		double sortTime = secondsSince(start);
+
+		size_t found = 0;
+		for (auto& group : hashGroups) found += group.size() - 1;
+		std::cout << "Duplicate element benchmark (" << noElements << " elements)\n";
+		std::cout << "  std::map, ordered pairs: " << legacyTime << " s, found " << legacyFound << "\n";
+		std::cout << "  hash, either direction : " << hashTime << " s, found " << found << " in " << hashGroups.size() << " groups\n";
+		std::cout << "  parallel sort          : " << sortTime << " s, same groups " << (sortGroups == hashGroups ? "yes" : "NO") << "\n";
+		//the ordered pairs miss the reversed repeats, never more
+		return verdict(sortGroups == hashGroups && found >= legacyFound && found >= noElements / 4);
+	}
+
+	//A sizing loop: every section is edited once per iteration. Times modifySection against the old full reCalc of the
+	//section's elements and checks the element matrices are the same.
+	bool sectionEdits(size_t noElements = 200000, size_t noSections = 400, size_t noIterations = 5) {
+		Beams::Model model;
+		std::mt19937 gen(3);
+		std::uniform_real_distribution<float> coord(-1000.f, 1000.f);
+		for (size_t i = 0; i < noSections; i++) model.addSection(100, 210000, 80000, 1000, 100, 100);
+		for (size_t i = 0; i < 3 * noElements; i++) model.addNode(Vector3{ coord(gen), coord(gen), coord(gen) });
+		for (size_t i = 0; i < noElements; i++) model.addElement(3 * i, 3 * i + 1, 3 * i + 2, i % noSections);
+
+		auto start = std::chrono::steady_clock::now();
+		for (size_t it = 0; it < noIterations; it++) {
+			for (size_t sec = 0; sec < noSections; sec++) model.modifySection(sec, 100 + it, 210000, 80000, 1000, 100 + it, 100 + sec);
+		}
+		double editTime = secondsSince(start);
+
+		//old lookup for one section: every element searched in the section's element list
+		const std::vector<size_t>& inElements = model.getSections().at(0).inElements;
+		size_t legacyFound = 0;
+		start = std::chrono::steady_clock::now();
+		for (size_t ePos = 0; ePos < noElements; ePos++) legacyFound += std::find(inElements.begin(), inElements.end(), ePos) != inElements.end();
+		double legacyTime = secondsSince(start);
+
+		//same final sections, every element rebuilt from the nodes
+		Beams::NodeContainer nodes;
+		for (auto& node : model.getNodes()) {
+			Vector3 point{ (float)node.x, (float)node.y, (float)node.z };
+			nodes.emplace(point);
+		}
+		std::vector<Beams::vBeam> elements(model.getElements().begin(), model.getElements().end());
+		Beams::LocalStiffnessCache rebuilt;
+		start = std::chrono::steady_clock::now();
+		for (auto& element : elements) element.reCalc(nodes, model.getSections().at(element.getSectionId()), rebuilt);
+		double reCalcTime = secondsSince(start);
+
+		double maxRelDiff = 0;
+		for (size_t i = 0; i < noElements; i++) {
+			const Beams::Matrix12d& edited = model.getElements()[i].getLocalStiffness();
+			maxRelDiff = std::max(maxRelDiff, (edited - elements[i].getLocalStiffness()).cwiseAbs().maxCoeff() / edited.cwiseAbs().maxCoeff());
+		}
+
+		std::cout << "Section edit benchmark (" << noElements << " elements, " << noSections << " sections, " << noIterations << " iterations)\n";
+		std::cout << "  old element scan, 1 section: " << legacyTime << " s (" << legacyFound << " elements), ~" << legacyTime * noSections << " s per iteration\n";
+		std::cout << "  modifySection, all sections: " << editTime / noIterations << " s per iteration\n";
+		std::cout << "  full reCalc of all elements: " << reCalcTime << " s\n";
+		std::cout << "  max rel. diff              : " << maxRelDiff << "\n";
+		return verdict(maxRelDiff <= REL_TOLERANCE);
+	}
+
+	//vBeam construction (array of fat objects, one element at a time) against the structure of arrays store on the scalar
+	//and the widest compiled vector path. All three have to agree on lengths, frames and global matrices.
+	bool elementStore(size_t noElements = 1000000) {
+		Beams::Section section(100, 210000, 80000, 1000, 100, 100);
+		std::map<size_t, Beams::Section> sections{ { 0, section } };
+		Beams::NodeContainer nodes;
+		std::vector<Beams::vBeam> elements;
+		Beams::LocalStiffnessCache cache, rebuilt;
+		makeRandomElements(noElements, nodes, elements, section, cache);
+		auto start = std::chrono::steady_clock::now();
+		for (auto& element : elements) element.reCalc(nodes, section, rebuilt);
+		double objectTime = secondsSince(start);
+
+		Beams::ElementStore scalar, vector;
+		scalar.assign(elements);
+		vector.assign(elements);
+		start = std::chrono::steady_clock::now();
+		scalar.update(nodes, sections, 1, Beams::KernelPath::Scalar);
+		double scalarTime = secondsSince(start);
+		start = std::chrono::steady_clock::now();
+		vector.update(nodes, sections, 1);
+		double vectorTime = secondsSince(start);
+
+		double maxScalarDiff = 0, maxElementDiff = 0;
+		Beams::Matrix12d fromElement, fromScalar, fromVector;
+		for (size_t i = 0; i < noElements; i++) {
+			elements[i].calc_GlobalStiffness(fromElement);
+			scalar.calc_GlobalStiffness(i, fromScalar);
+			vector.calc_GlobalStiffness(i, fromVector);
+			double scale = fromElement.cwiseAbs().maxCoeff();
+			maxScalarDiff = std::max(maxScalarDiff, (fromVector - fromScalar).cwiseAbs().maxCoeff() / scale);
+			maxElementDiff = std::max(maxElementDiff, (fromVector - fromElement).cwiseAbs().maxCoeff() / scale);
+			maxElementDiff = std::max(maxElementDiff, std::abs(vector.getLength(i) - elements[i].getLength()) / elements[i].getLength());
+		}
+
+		std::cout << "Element store benchmark (" << noElements << " elements, vector width " << (int)Beams::ElementStore::widestPath() << ")\n";
+		std::cout << "  vBeam::reCalc       : " << objectTime << " s\n";
+		std::cout << "  SoA scalar          : " << scalarTime << " s\n";
+		std::cout << "  SoA vector          : " << vectorTime << " s\n";
+		std::cout << "  max rel. diff scalar: " << maxScalarDiff << "\n";
+		std::cout << "  max rel. diff vBeam : " << maxElementDiff << "\n";
+		return verdict(maxScalarDiff <= REL_TOLERANCE && maxElementDiff <= REL_TOLERANCE);
+	}
+
+	//IC(0) of a positive definite matrix whose unshifted factorization breaks down. On its pattern L L^T has to reproduce
+	//K + shift*diag(K) for the shift compute() settled on.
+	bool incompleteCholesky() {
+		Eigen::MatrixXd K(4, 4);
+		K << 3, -2, 0, 2,
+			-2, 3, -2, 0,
+			0, -2, 3, -2,
+			2, 0, -2, 3;
+		Eigen::MatrixXd lowerDense = K.triangularView<Eigen::Lower>();
+		Eigen::SparseMatrix<double> lower = lowerDense.sparseView();
+		Beams::IncompleteCholesky0 ic;
+		bool factorized = ic.compute(lower);
+
+		double maxDiff = 0;
+		if (factorized) {
+			Eigen::MatrixXd L = ic.getFactor();
+			Eigen::MatrixXd LLt = L * L.transpose();
+			for (Eigen::Index j = 0; j < lower.outerSize(); j++) {
+				for (Eigen::SparseMatrix<double>::InnerIterator it(lower, j); it; ++it) {
+					double expected = it.value() * ((it.row() == j) ? 1 + ic.getShift() : 1);
+					maxDiff = std::max(maxDiff, std::abs(LLt(it.row(), j) - expected));
+				}
+			}
+		}
+
+		std::cout << "IC(0) breakdown check\n";
+		std::cout << "  factorized       : " << (factorized ? "yes" : "NO") << ", shift " << ic.getShift() << "\n";
+		std::cout << "  max diff on K    : " << maxDiff << "\n";
+		return verdict(factorized && maxDiff <= REL_TOLERANCE * K.cwiseAbs().maxCoeff());
+	}
+
+	//Nodes of a regular frame of storeys, section 0 for beams and 1 for columns. Returns the orientation node, the last one.
+	static inline size_t makeFrameNodes(Beams::Model& model, size_t baysX, size_t baysY, size_t storeys) {
+		model.addSection(100, 210000, 80000, 1000, 100, 100); //beams
+		model.addSection(200, 210000, 80000, 2000, 300, 200); //columns
+		for (size_t k = 0; k <= storeys; k++) {
+			for (size_t j = 0; j <= baysY; j++) {
+				for (size_t i = 0; i <= baysX; i++) model.addNode(Vector3{ (float)i * 6000.f, (float)j * 7500.f, (float)k * 3500.f });
+			}
+		}
+		model.addNode(Vector3{ -1000, -1000, -1000 });
+		return (storeys + 1) * (baysY + 1) * (baysX + 1);
+	}
+
+	static inline void makeFrameElements(Beams::Model& model, size_t baysX, size_t baysY, size_t storeys, size_t refNode) {
+		auto id = [&](size_t i, size_t j, size_t k) {return (k * (baysY + 1) + j) * (baysX + 1) + i; };
+		for (size_t k = 0; k <= storeys; k++) {
+			for (size_t j = 0; j <= baysY; j++) {
+				for (size_t i = 0; i <= baysX; i++) {
+					if (k > 0 && i < baysX) model.addElement(id(i, j, k), id(i + 1, j, k), refNode, 0);
+					if (k > 0 && j < baysY) model.addElement(id(i, j, k), id(i, j + 1, k), refNode, 0);
+					if (k < storeys) model.addElement(id(i, j, k), id(i, j, k + 1), refNode, 1);
+				}
+			}
+		}
+	}
+
+	//Storeys of a regular frame: bays, columns and copied storeys share a few local matrices. Reports the cache hit rate
+	//and the local matrix memory against one private matrix per element.
+	bool stiffnessCache(size_t baysX = 40, size_t baysY = 40, size_t storeys = 60) {
+		Beams::Model model;
+		size_t refNode = makeFrameNodes(model, baysX, baysY, storeys);
+		auto start = std::chrono::steady_clock::now();
+		makeFrameElements(model, baysX, baysY, storeys, refNode);
+		double buildTime = secondsSince(start);
+
+		const Beams::StiffnessCacheStats& stats = model.getStiffnessCacheStats();
+		size_t noElements = model.getElements().size();
+		std::cout << "Stiffness cache benchmark (" << noElements << " elements)\n";
+		std::cout << "  element creation: " << buildTime << " s\n";
+		std::cout << "  local matrices  : " << stats.entries << ", hit rate " << 100 * stats.hitRate() << " %\n";
+		std::cout << "  matrix memory   : " << stats.entries * sizeof(Beams::Matrix12d) / 1024 << " kB instead of " << noElements * sizeof(Beams::Matrix12d) / 1024 << " kB\n";
+
+		//without the columns their matrices are unused: the cache has to drop them and keep the beams pointing at valid ones
+		std::vector<size_t> columns;
+		for (size_t ePos = 0; ePos < noElements; ePos++) {
+			if (model.getElements()[ePos].getSectionId() == 1) columns.push_back(ePos);
+		}
+		model.removeElements(columns);
+		std::unordered_set<const Beams::Matrix12d*> inUse;
+		Beams::LocalStiffnessCache fresh;
+		double maxRelDiff = 0;
+		for (auto& element : model.getElements()) {
+			inUse.insert(&element.getLocalStiffness());
+			const Beams::Matrix12d& expected = fresh.get(element.getSectionId(), model.getSections().at(element.getSectionId()), element.getLength());
+			maxRelDiff = std::max(maxRelDiff, (element.getLocalStiffness() - expected).cwiseAbs().maxCoeff() / expected.cwiseAbs().maxCoeff());
+		}
+		std::cout << "  without columns : " << stats.entries << " local matrices, " << inUse.size() << " in use, " << stats.dropped << " dropped, max rel. diff " << maxRelDiff << "\n";
+		return verdict(stats.entries == inUse.size() && maxRelDiff <= REL_TOLERANCE);
+	}
+
+	//The same frame built with single addElement calls and inside one beginBatch/commit, against a plain copy of the
+	//finished element array. Both models must hold the same elements and the batch must bump the revision once.
+	bool batchEdits(size_t baysX = 40, size_t baysY = 40, size_t storeys = 60) {
+		Beams::Model single, batched;
+		size_t refNode = makeFrameNodes(single, baysX, baysY, storeys);
+		makeFrameNodes(batched, baysX, baysY, storeys);
+
+		auto start = std::chrono::steady_clock::now();
+		makeFrameElements(single, baysX, baysY, storeys, refNode);
+		double singleTime = secondsSince(start);
+
+		size_t revisionBefore = batched.getRevision();
+		start = std::chrono::steady_clock::now();
+		batched.beginBatch(0, single.getElements().size());
+		makeFrameElements(batched, baysX, baysY, storeys, refNode);
+		batched.commit();
+		double batchTime = secondsSince(start);
+		size_t revisionBumps = batched.getRevision() - revisionBefore;
+
+		start = std::chrono::steady_clock::now();
+		std::vector<Beams::vBeam> copy(single.getElements());
+		double copyTime = secondsSince(start);
+
+		const std::vector<Beams::vBeam>& a = single.getElements();
+		const std::vector<Beams::vBeam>& b = batched.getElements();
+		bool same = a.size() == b.size();
+		Beams::Matrix12d ka, kb;
+		for (size_t i = 0; same && i < a.size(); i++) {
+			a[i].calc_GlobalStiffness(ka);
+			b[i].calc_GlobalStiffness(kb);
+			same = a[i].node1Pos == b[i].node1Pos && a[i].node2Pos == b[i].node2Pos && a[i].getSectionId() == b[i].getSectionId() && ka == kb;
+		}
+
+		std::cout << "Batch edit benchmark (" << a.size() << " elements, " << copy.size() * sizeof(Beams::vBeam) / (1024 * 1024) << " MB)\n";
+		std::cout << "  single addElement: " << singleTime << " s\n";
+		std::cout << "  one batch        : " << batchTime << " s, " << revisionBumps << " revision bump(s)\n";
+		std::cout << "  element copy     : " << copyTime << " s\n";
+		std::cout << "  same elements    : " << (same ? "yes" : "NO") << "\n";
+
+		//ids run ahead of the slots once elements are removed, a batch after a removal has to map the new ids to their slots
+		Beams::Model edited;
+		refNode = makeFrameNodes(edited, 3, 3, 2);
+		makeFrameElements(edited, 3, 3, 2, refNode);
+		edited.removeElements({ 0, 1, 2, 3, 4 });
+		edited.copyElements({ 0, 1 }, Vector3{ 0, 0, 10000 });
+		const std::vector<Beams::vBeam>& e = edited.getElements();
+		bool idsMapped = true;
+		for (size_t ePos = 0; ePos < e.size(); ePos++) idsMapped = idsMapped && edited.getElementPos_byId(e[ePos].getID()) == ePos;
+		for (Eigen::Index id = 0; id < 5; id++) idsMapped = idsMapped && edited.getElementPos_byId(id) == Beams::Model::NO_ELEMENT;
+		std::cout << "  ids after removal: " << (idsMapped ? "mapped" : "WRONG SLOTS") << "\n";
+		return verdict(same && revisionBumps == 1 && idsMapped);
+	}
+
+	//A frame with supports and loads saved as v1 and v2. Mapping and checking the v2 file is compared with a plain read of
+	//the same number of bytes, i.e. the disk bandwidth; the rest of a load is building the model. Both reloaded models must
+	//match the original.
+	bool modelFile(size_t baysX = 90, size_t baysY = 90, size_t storeys = 80, std::string folder = "") {
+		Beams::Model model;
+		size_t refNode = makeFrameNodes(model, baysX, baysY, storeys);
+		model.beginBatch();
+		makeFrameElements(model, baysX, baysY, storeys, refNode);
+		model.commit();
+		for (size_t i = 0; i < (baysX + 1) * (baysY + 1); i++) model.addBCfixed(i);
+		model.addBCfixed(refNode);
+		for (size_t i = 0; i < baysX; i++) model.addForce(refNode - 1 - i, 1, 1000); //v1 stores forces as float
+
+		std::string v1Name = folder + "benchmark_v1.vbeam", v2Name = folder + "benchmark_v2.vbeam";
+		auto start = std::chrono::steady_clock::now();
+		Saving::saveModelV1(model, v1Name);
+		double saveV1Time = secondsSince(start);
+		start = std::chrono::steady_clock::now();
+		Saving::saveModel(model, v2Name);
+		double saveV2Time = secondsSince(start);
+
+		start = std::chrono::steady_clock::now();
+		std::ifstream raw(v2Name, std::ios_base::binary | std::ios_base::ate);
+		std::vector<char> bytes((size_t)raw.tellg());
+		raw.seekg(0);
+		raw.read(bytes.data(), bytes.size());
+		double readTime = secondsSince(start);
+
+		start = std::chrono::steady_clock::now();
+		bool checked;
+		{
+			Saving::V2::MappedFile file;
+			Saving::V2::Reader reader(file);
+			checked = file.open(v2Name) && reader.validate();
+		}
+		double checkTime = secondsSince(start);
+
+		auto sameModel = [&](Beams::Model& other) {
+			const std::vector<Beams::vBeam>& a = model.getElements();
+			const std::vector<Beams::vBeam>& b = other.getElements();
+			if (a.size() != b.size() || model.getNodes().size() != other.getNodes().size() || model.getBCfixed() != other.getBCfixed()) return false;
+			if (model.getForces() != other.getForces()) return false;
+			for (auto& node : model.getNodes()) {
+				const Beams::Node& copy = other.getNodes().get_byPos(node.pos);
+				if (node.x != copy.x || node.y != copy.y || node.z != copy.z) return false;
+			}
+			for (size_t i = 0; i < a.size(); i++) {
+				if (a[i].node1Pos != b[i].node1Pos || a[i].node2Pos != b[i].node2Pos || a[i].node3Pos != b[i].node3Pos || a[i].getSectionId() != b[i].getSectionId()) return false;
+			}
+			return true;
+		};
+		//one loaded model at a time, so both loads start from the same free memory
+		auto timedLoad = [&](const std::string& fname, double& seconds) {
+			Beams::Model loaded;
+			auto loadStart = std::chrono::steady_clock::now();
+			bool ok = Saving::loadModel(loaded, fname);
+			seconds = secondsSince(loadStart);
+			return ok && sameModel(loaded);
+		};
+		double loadV1Time, loadV2Time;
+		bool sameV1 = timedLoad(v1Name, loadV1Time);
+		bool sameV2 = timedLoad(v2Name, loadV2Time);
+
+		std::cout << "Model file benchmark (" << model.getElements().size() << " elements, v2 file " << bytes.size() / (1024 * 1024) << " MB)\n";
+		std::cout << "  save v1          : " << saveV1Time << " s\n";
+		std::cout << "  save v2          : " << saveV2Time << " s\n";
+		std::cout << "  load v1          : " << loadV1Time << " s\n";
+		std::cout << "  load v2          : " << loadV2Time << " s\n";
+		std::cout << "  v2 map + checks  : " << checkTime << " s" << (checked ? "" : " (FAILED)") << "\n";
+		std::cout << "  plain read       : " << readTime << " s\n";
+		std::cout << "  same model       : v1 " << (sameV1 ? "yes" : "NO") << ", v2 " << (sameV2 ? "yes" : "NO") << "\n";
+		std::remove(v1Name.c_str());
+		std::remove(v2Name.c_str());
+		return verdict(checked && sameV1 && sameV2);
+	}
+
+	//File size and time of a frame as v2 and as stream files with and without float packing, and a frame written straight
+	//from its generator and read back a chunk at a time, without a model in memory. Both reads must give back what was written.
+	bool modelStream(size_t baysX = 40, size_t baysY = 40, size_t storeys = 60, std::string folder = "") {
+		Beams::Model model;
+		size_t refNode = makeFrameNodes(model, baysX, baysY, storeys);
+		model.beginBatch();
+		makeFrameElements(model, baysX, baysY, storeys, refNode);
+		model.commit();
+		for (size_t i = 0; i < (baysX + 1) * (baysY + 1); i++) model.addBCfixed(i);
+		model.addBCfixed(refNode);
+		for (size_t i = 0; i < baysX; i++) model.addForce(refNode - 1 - i, 1, 1000.0 / 3);
+
+		auto fileSize = [](const std::string& fname) {
+			std::ifstream in(fname, std::ios_base::binary | std::ios_base::ate);
+			return (double)in.tellg() / (1024 * 1024);
+		};
+		auto sameModel = [&](Beams::Model& other) {
+			const std::vector<Beams::vBeam>& a = model.getElements();
+			const std::vector<Beams::vBeam>& b = other.getElements();
+			if (a.size() != b.size() || model.getNodes().size() != other.getNodes().size() || model.getForces() != other.getForces()) return false;
+			for (auto& node : model.getNodes()) {
+				const Beams::Node& copy = other.getNodes().get_byPos(node.pos);
+				if (node.x != copy.x || node.y != copy.y || node.z != copy.z) return false;
+			}
+			for (size_t i = 0; i < a.size(); i++) {
+				if (a[i].node1Pos != b[i].node1Pos || a[i].node2Pos != b[i].node2Pos || a[i].node3Pos != b[i].node3Pos || a[i].getSectionId() != b[i].getSectionId()) return false;
+			}
+			return true;
+		};
+
+		std::string v2Name = folder + "benchmark_v2.vbeam", rawName = folder + "benchmark_raw.vbeam", packedName = folder + "benchmark_packed.vbeam";
+		auto start = std::chrono::steady_clock::now();
+		Saving::saveModel(model, v2Name);
+		double v2Time = secondsSince(start);
+		Saving::Stream::Options options;
+		options.packFloats = false;
+		start = std::chrono::steady_clock::now();
+		Saving::saveModelStream(model, rawName, options);
+		double rawTime = secondsSince(start);
+		options.packFloats = true;
+		start = std::chrono::steady_clock::now();
+		Saving::saveModelStream(model, packedName, options);
+		double packedTime = secondsSince(start);
+
+		bool same;
+		double loadTime;
+		{
+			Beams::Model loaded;
+			start = std::chrono::steady_clock::now();
+			same = Saving::loadModelStream(loaded, packedName) && sameModel(loaded);
+			loadTime = secondsSince(start);
+		}
+
+		std::cout << "Model stream benchmark (" << model.getElements().size() << " elements)\n";
+		std::cout << "  v2             : " << fileSize(v2Name) << " MB, " << v2Time << " s\n";
+		std::cout << "  stream         : " << fileSize(rawName) << " MB, " << rawTime << " s\n";
+		std::cout << "  stream, packed : " << fileSize(packedName) << " MB, " << packedTime << " s\n";
+		std::cout << "  packed load    : " << loadTime << " s, same model: " << (same ? "yes" : "NO") << "\n";
+		std::remove(v2Name.c_str());
+		std::remove(rawName.c_str());
+
+		//4x the storeys, never held as a model: the reader only keeps one chunk
+		size_t bigStoreys = 4 * storeys;
+		start = std::chrono::steady_clock::now();
+		Saving::Stream::Writer writer;
+		writer.open(packedName);
+		writer.addSection(100, 210000, 80000, 1000, 100, 100);
+		writer.addSection(200, 210000, 80000, 2000, 300, 200);
+		for (size_t k = 0; k <= bigStoreys; k++) {
+			for (size_t j = 0; j <= baysY; j++) {
+				for (size_t i = 0; i <= baysX; i++) writer.addNode(i * 6000., j * 7500., k * 3500.);
+			}
+		}
+		uint64_t bigRef = writer.addNode(-1000, -1000, -1000);
+		auto id = [&](size_t i, size_t j, size_t k) {return (k * (baysY + 1) + j) * (baysX + 1) + i; };
+		uint64_t noElements = 0;
+		for (size_t k = 0; k <= bigStoreys; k++) {
+			for (size_t j = 0; j <= baysY; j++) {
+				for (size_t i = 0; i <= baysX; i++) {
+					if (k > 0 && i < baysX) noElements = writer.addElement(id(i, j, k), id(i + 1, j, k), bigRef, 0) + 1;
+					if (k > 0 && j < baysY) noElements = writer.addElement(id(i, j, k), id(i, j + 1, k), bigRef, 0) + 1;
+					if (k < bigStoreys) noElements = writer.addElement(id(i, j, k), id(i, j, k + 1), bigRef, 1) + 1;
+				}
+			}
+		}
+		writer.close();
+		double writeTime = secondsSince(start);
+
+		start = std::chrono::steady_clock::now();
+		uint64_t readElements = 0, columns = 0, noChunks = 0;
+		bool complete = Saving::Stream::read(packedName, [&](const Saving::Stream::Chunk& chunk, const Saving::Stream::Progress&) {
+			noChunks++;
+			if (chunk.kind == Saving::Stream::ChunkKind::Elements) {
+				readElements += chunk.count;
+				for (uint64_t sec : chunk.section) columns += sec;
+			}
+			return true;
+		});
+		double readTime = secondsSince(start);
+
+		std::cout << "  generated      : " << noElements << " elements, " << fileSize(packedName) << " MB, written in " << writeTime << " s\n";
+		std::cout << "  chunked read   : " << readTime << " s, " << noChunks << " chunks, " << readElements << " elements, " << columns << " columns"
+			<< (complete && readElements == noElements ? "" : " (INCOMPLETE)") << "\n";
+		std::remove(packedName.c_str());
+		return verdict(same && complete && readElements == noElements);
+	}
+
+	//v2 load of a 2M element frame on 1, 2, 4 ... threads up to all cores. Every load must give the same elements and the same
+	//result as the first one.
+	bool parallelLoad(size_t baysX = 90, size_t baysY = 90, size_t storeys = 80, std::string folder = "") {
+		std::string fname = folder + "benchmark_load.vbeam";
+		size_t noElements;
+		{
+			Beams::Model model;
+			size_t refNode = makeFrameNodes(model, baysX, baysY, storeys);
+			model.beginBatch();
+			makeFrameElements(model, baysX, baysY, storeys, refNode);
+			model.commit();
+			noElements = model.getElements().size();
+			Saving::saveModel(model, fname);
+		}
+
+		std::cout << "Parallel load benchmark (" << noElements << " elements)\n";
+		unsigned noCores = std::max(1u, std::thread::hardware_concurrency());
+		std::vector<Beams::vBeam> reference;
+		bool allSame = true;
+		for (unsigned noThreads = 1; noThreads <= noCores; noThreads = (noThreads == noCores) ? noThreads + 1 : std::min(2 * noThreads, noCores)) {
+			Beams::Model loaded;
+			loaded.setAssemblyThreads(noThreads);
+			auto start = std::chrono::steady_clock::now();
+			bool ok = Saving::loadModel(loaded, fname);
+			double loadTime = secondsSince(start);
+
+			const std::vector<Beams::vBeam>& elements = loaded.getElements();
+			bool same = ok && elements.size() == noElements;
+			if (reference.empty()) reference = elements;
+			Beams::Matrix12d ka, kb;
+			for (size_t i = 0; same && i < elements.size(); i += 97) {
+				reference[i].calc_GlobalStiffness(ka);
+				elements[i].calc_GlobalStiffness(kb);
+				same = elements[i].node1Pos == reference[i].node1Pos && elements[i].node2Pos == reference[i].node2Pos && ka == kb;
+			}
+			std::cout << "  " << noThreads << " thread(s): " << loadTime << " s" << (same ? "" : " (DIFFERENT)") << "\n";
+			allSame = allSame && same;
+		}
+		std::remove(fname.c_str());
+		return verdict(allSame);
+	}
+
+	//Solving a frame with 2 load cases against loading the model and its saved results. The loaded results must match the
+	//solved ones.
+	bool resultsFile(size_t baysX = 15, size_t baysY = 15, size_t storeys = 10, std::string folder = "") {
+		std::string modelName = folder + "benchmark_results.vbeam", resultsName = Saving::resultsFileName(modelName);
+		Beams::Model model;
+		size_t refNode = makeFrameNodes(model, baysX, baysY, storeys);
+		makeFrameElements(model, baysX, baysY, storeys, refNode);
+		for (size_t i = 0; i < (baysX + 1) * (baysY + 1); i++) model.addBCfixed(i);
+		for (size_t i = 0; i < baysX; i++) model.addForce(refNode - 1 - i, 1, 1000);
+		model.setActiveLoadCase("wind");
+		for (size_t k = 1; k <= storeys; k++) model.addForce(k * (baysY + 1) * (baysX + 1), 0, 500);
+		model.setActiveLoadCase(Beams::DEFAULT_LOADCASE);
+
+		auto start = std::chrono::steady_clock::now();
+		model.solve();
+		double solveTime = secondsSince(start);
+		start = std::chrono::steady_clock::now();
+		Saving::saveModel(model, modelName);
+		bool saved = Saving::saveResults(model, resultsName);
+		double saveTime = secondsSince(start);
+
+		Beams::Model loaded;
+		start = std::chrono::steady_clock::now();
+		bool ok = Saving::loadModel(loaded, modelName);
+		double loadTime = secondsSince(start);
+		start = std::chrono::steady_clock::now();
+		ok = ok && Saving::loadResults(loaded, resultsName);
+		double resultsTime = secondsSince(start);
+
+		double maxDiff = 0, maxDispl = 0;
+		for (const std::string& name : model.getSolvedCases()) {
+			Eigen::VectorXd a = model.getDisplacements(name), b = loaded.getDisplacements(name);
+			auto nodeB = loaded.getNodes().begin();
+			for (auto& node : model.getNodes()) {
+				if (!node.free_flag) {
+					for (int d = 0; d < 6; d++) maxDiff = std::max(maxDiff, std::abs(a(6 * node.matrixPos + d) - b(6 * nodeB->matrixPos + d)));
+				}
+				++nodeB;
+			}
+			maxDispl = std::max(maxDispl, a.cwiseAbs().maxCoeff());
+		}
+
+		std::cout << "Results file benchmark (" << model.getElements().size() << " elements, 2 load cases)\n";
+		std::cout << "  solve            : " << solveTime << " s\n";
+		std::cout << "  save model+result: " << saveTime << " s" << (saved ? "" : " (FAILED)") << "\n";
+		std::cout << "  load model       : " << loadTime << " s\n";
+		std::cout << "  load results     : " << resultsTime << " s" << (ok && loaded.isSolved() ? "" : " (FAILED)") << "\n";
+		std::cout << "  max displ. diff  : " << maxDiff << "\n";
+		std::remove(modelName.c_str());
+		std::remove(resultsName.c_str());
+		return verdict(saved && ok && loaded.isSolved() && maxDiff <= REL_TOLERANCE * maxDispl);
+	}
+
+	//A frame solved in two models, as by two sessions: the second reads the factor from the cache. Then a section change
+	//(new stiffness, new factor) with a cap of one factor, which evicts the older one. The cached solve must match.
+	bool factorCache(size_t baysX = 15, size_t baysY = 15, size_t storeys = 10, std::string folder = "") {
+		std::string directory = folder + "benchmark_factors";
+		auto makeModel = [&](Beams::Model& model) {
+			size_t refNode = makeFrameNodes(model, baysX, baysY, storeys);
+			makeFrameElements(model, baysX, baysY, storeys, refNode);
+			for (size_t i = 0; i < (baysX + 1) * (baysY + 1); i++) model.addBCfixed(i);
+			for (size_t i = 0; i < baysX; i++) model.addForce(refNode - 1 - i, 1, 1000);
+			model.setFactorCache(directory);
+		};
+		auto directoryBytes = [&]() {
+			uintmax_t bytes = 0;
+			for (auto& item : std::filesystem::directory_iterator(directory)) bytes += item.file_size();
+			return bytes;
+		};
+
+		Beams::Model first;
+		makeModel(first);
+		auto start = std::chrono::steady_clock::now();
+		first.solve();
+		double factorizeTime = secondsSince(start);
+		uintmax_t factorBytes = directoryBytes();
+
+		Beams::Model second;
+		makeModel(second);
+		start = std::chrono::steady_clock::now();
+		second.solve();
+		double cachedTime = secondsSince(start);
+
+		double maxDiff = 0;
+		Eigen::VectorXd a = first.getDisplacements(Beams::DEFAULT_LOADCASE), b = second.getDisplacements(Beams::DEFAULT_LOADCASE);
+		for (auto& node : first.getNodes()) {
+			if (node.free_flag) continue;
+			size_t other = second.getNodes().get_byPos(node.pos).matrixPos;
+			for (int d = 0; d < 6; d++) maxDiff = std::max(maxDiff, std::abs(a(6 * node.matrixPos + d) - b(6 * other + d)));
+		}
+		bool hit = second.getFactorCacheStats().hits == 1;
+
+		second.setFactorCache(directory, factorBytes);
+		second.modifySection(1, 250, 210000, 80000, 2500, 350, 250);
+		second.solve();
+
+		std::cout << "Factor cache benchmark (" << first.getElements().size() << " elements, " << factorBytes / 1024 << " KiB factor)\n";
+		std::cout << "  factorize + store : " << factorizeTime << " s\n";
+		std::cout << "  cached solve      : " << cachedTime << " s" << (hit ? "" : " (NO HIT)") << "\n";
+		std::cout << "  max displ. diff   : " << maxDiff << "\n";
+		std::cout << "  evicted at cap    : " << second.getFactorCacheStats().evictions << " (expected 1), " << directoryBytes() / 1024 << " KiB left\n";
+		size_t evictions = second.getFactorCacheStats().evictions;
+		std::filesystem::remove_all(directory);
+		return verdict(hit && maxDiff <= REL_TOLERANCE * a.cwiseAbs().maxCoeff() && evictions == 1);
+	}
+
+	//Runs every benchmark, also after a failed one. False if any check failed.
+	bool runAll() {
+		size_t failed = 0;
+		failed += !elementKernels();
+		failed += !duplicateNodes();
+		failed += !duplicateElements();
+		failed += !sectionEdits();
+		failed += !elementStore();
+		failed += !incompleteCholesky();
+		failed += !stiffnessCache();
+		failed += !batchEdits();
+		failed += !modelFile();
+		failed += !modelStream();
+		failed += !parallelLoad();
+		failed += !resultsFile();
+		failed += !factorCache();
+		if (failed) std::cout << failed << " benchmark(s) FAILED their checks\n";
+		else std::cout << "All benchmark checks passed\n";
+		return failed == 0;
+	}
+}
@@ -433,6 +433,15 @@ namespace Rendering{
             int activeDropdownMenu = 0; //Which action section (for nodes, elements, sections etc) is currently active
             SelectionBox selectionBox;
         };
+
+        //Element positions shift when elements are removed. Maps a selection through Model::removeElements' remap and drops removed ones
+        void remapSelection(std::vector<size_t>& selection, const std::vector<size_t>& remap) {
+            size_t write = 0;
+            for (size_t pos : selection) {
+                if (pos < remap.size() && remap[pos] != Beams::Model::NO_ELEMENT) selection[write++] = remap[pos];
+            }
+            selection.resize(write);
+        }
     }
 
     void getInput_CameraControl(Camera3D& camera, Beams::Model& model);
@@ -455,6 +464,13 @@ namespace Rendering{
 
         SetupScene(camera);
 
+        // Factors of earlier sessions, next to the executable or in the temp dir if that cannot be created. 2 GiB at most
+        std::error_code cacheError;
+        std::filesystem::path cacheDirectory = std::filesystem::path(GetApplicationDirectory()) / "factor_cache";
+        std::filesystem::create_directories(cacheDirectory, cacheError);
+        if (!std::filesystem::is_directory(cacheDirectory, cacheError)) cacheDirectory = std::filesystem::temp_directory_path(cacheError) / "vbeam_factor_cache";
+        model.setFactorCache(cacheDirectory.string());
+
         // Custom file dialog
         GuiWindowFileDialogState fileDialogState = InitGuiWindowFileDialog(GetWorkingDirectory());
         char fileNameToLoad[512] = { 0 };
@@ -472,11 +488,13 @@ namespace Rendering{
                 // load file 
                 if (!fileDialogState.saveFileMode) {
                     strcpy(fileNameToLoad, TextFormat("%s" PATH_SEPERATOR "%s", fileDialogState.dirPathText, fileDialogState.fileNameText));
-                    Saving::loadModel(model, fileNameToLoad);
+                    //results saved next to the model are shown right away if they still match it
+                    if (Saving::loadModel(model, fileNameToLoad) && Saving::loadResults(model, Saving::resultsFileName(fileNameToLoad))) modelState.deformed = true;
                 }
                 else {
                     strcpy(fileNameToLoad, TextFormat("%s" PATH_SEPERATOR "%s.vbeam", fileDialogState.dirPathText, fileDialogState.fileNameText));
                     Saving::saveModel(model, fileNameToLoad);
+                    if (model.isSolved()) Saving::saveResults(model, Saving::resultsFileName(fileNameToLoad));
                 }
            
 
@@ -807,10 +825,9 @@ namespace Rendering{
 
                 if (!showingDuplicates) {
                     if (GuiButton(OkButPos, "REMOVE") || IsMouseButtonReleased(MOUSE_BUTTON_RIGHT)) {
-                        std::sort(selectedNodes.rbegin(), selectedNodes.rend());
-                        for (size_t selected : selectedNodes) {
-                            model.removeNode(selected);
-                        }
+                        std::vector<size_t> elemRemap = model.removeNodes(selectedNodes);
+                        remapSelection(selectedElems, elemRemap);
+                        remapSelection(infoElems, elemRemap);
                         selectedNodes.clear();
                     };
 
@@ -895,33 +912,31 @@ namespace Rendering{
         if (GuiFlags::EL_REMOVE_ACTIVE & ActionFlags) {
             {
                 static bool showingDuplicates = false;
-                static std::vector<size_t> duplicateElemPositions;
+                static std::vector<std::vector<size_t>> duplicateElemGroups;
 
                 if (GuiWindowBox(windowPos, "RemoveElement")) ActionFlags &= ~GuiFlags::EL_REMOVE_ACTIVE;
                 GuiLabel(textPos, "Pick elements with lClick (or BoxSelect).\nUnpick with LeftCtrl + lClick (or BoxSelect).\nCLEAR clears selection. Remove (or rClick) removes selected.\nDuplicate Elements are only counted if duplicate Nodes are removed");
                 if (!showingDuplicates) {
                     if (GuiButton(OkButPos, "REMOVE") || IsMouseButtonReleased(MOUSE_BUTTON_RIGHT)) {
-                        std::sort(selectedElems.rbegin(), selectedElems.rend());//reverse sort
-                        for (size_t selected : selectedElems) {
-                            model.removeElement(selected);
-                        }
+                        std::vector<size_t> elemRemap = model.removeElements(selectedElems);
                         selectedElems.clear();
+                        remapSelection(infoElems, elemRemap);
 
                     };
                     if (GuiButton(MiddleButPos, "SHOW DUPLICATES")) {
                         selectedElems.clear();
-                        duplicateElemPositions.clear();
-                        duplicateElemPositions = model.findDuplicateElements();
-                        for (auto pos : duplicateElemPositions) selectedElems.push_back(pos);
+                        duplicateElemGroups = model.findDuplicateElements();
+                        for (auto& group : duplicateElemGroups) selectedElems.insert(selectedElems.end(), group.begin() + 1, group.end());
                         showingDuplicates = true;
                     }
                 }
                 else {
                     if (GuiButton(OkButPos, "REMOVE DUPLICATES") || IsMouseButtonReleased(MOUSE_BUTTON_RIGHT)) {
-                        model.removeDuplicateElems(duplicateElemPositions);
-                        duplicateElemPositions.clear();
+                        std::vector<size_t> elemRemap = model.removeDuplicateElems(duplicateElemGroups);
+                        duplicateElemGroups.clear();
                         showingDuplicates = false;
-                        selectedElems.clear();
+                        remapSelection(selectedElems, elemRemap);
+                        remapSelection(infoElems, elemRemap);
                     };
                 }
                 if (GuiButton(clearButPos, "CLEAR")) {
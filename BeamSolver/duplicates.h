@@ -0,0 +1,226 @@
+#pragma once
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cstdint>
+
+//Duplicate detection for the model cleanup tools. Works on plain arrays so it does not depend on the model classes.
+namespace Beams {
+	namespace Duplicates {
+
+		//Open addressing table from a key to a value, keys are never removed. Capacity is a power of 2 at least twice the key count.
+		template <typename Key, typename Hash>
+		class FlatTable {
+			std::vector<Key> keys;
+			std::vector<size_t> values;
+			std::vector<uint8_t> used;
+			size_t mask = 0;
+			Hash hash;
+
+		public:
+			explicit FlatTable(size_t noKeys) {
+				size_t capacity = 16;
+				while (capacity < 2 * noKeys) capacity *= 2;
+				keys.resize(capacity);
+				values.resize(capacity);
+				used.assign(capacity, 0);
+				mask = capacity - 1;
+			}
+
+			//Returns the value stored for key, or inserts value and returns it
+			size_t insert(const Key& key, size_t value) {
+				for (size_t slot = hash(key) & mask;; slot = (slot + 1) & mask) {
+					if (!used[slot]) {
+						used[slot] = 1;
+						keys[slot] = key;
+						values[slot] = value;
+						return value;
+					}
+					if (keys[slot] == key) return values[slot];
+				}
+			}
+
+			//SIZE_MAX if not found. Safe to call from several threads once all inserts are done
+			size_t find(const Key& key) const {
+				for (size_t slot = hash(key) & mask;; slot = (slot + 1) & mask) {
+					if (!used[slot]) return SIZE_MAX;
+					if (keys[slot] == key) return values[slot];
+				}
+			}
+		};
+
+		typedef std::array<int64_t, 3> Cell;
+
+		//splitmix64 finalizer, quantized coordinates often share their low bits
+		static inline uint64_t mix(uint64_t h) {
+			h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+			h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+			return h ^ (h >> 31);
+		}
+
+		struct CellHash {
+			size_t operator()(const Cell& c) const {
+				return (size_t)mix((uint64_t)c[0] * 0x9E3779B97F4A7C15ull ^ (uint64_t)c[1] * 0xC2B2AE3D27D4EB4Full ^ (uint64_t)c[2] * 0x165667B19E3779F9ull);
+			}
+		};
+
+		//Uniform grid with cells of 4x the tolerance: a point's tolerance box reaches a neighbouring cell only when the point is
+		//within the tolerance of that side, so most queries look at 1 to 8 cells instead of 27. Cells are centred on multiples of
+		//the cell size, so nodes on round coordinates do not sit on a cell border.
+		static inline Cell cellOf(const std::array<double, 3>& p, double cellSize) {
+			Cell c;
+			for (int a = 0; a < 3; a++) {
+				double q = std::floor(p[a] / cellSize + 0.5);
+				q = std::max(-4e18, std::min(4e18, q));
+				c[a] = (int64_t)q;
+			}
+			return c;
+		}
+
+		//For every point the lowest index of a point within tolerance on all 3 axes, chains resolved to their lowest index
+		//(a~b and b~c merge a, b & c). canonical[i] == i for points that are kept.
+		//parallelFor(count, func(begin,end)) runs the chunked loops; chunks only write their own entries.
+		template <typename ParallelFor>
+		std::vector<size_t> canonicalPoints(const std::vector<std::array<double, 3>>& points, double tolerance, ParallelFor parallelFor) {
+			size_t n = points.size();
+			tolerance = std::max(tolerance, 0.);
+			double cellSize = std::max(4 * tolerance, 1e-12);
+
+			std::vector<Cell> cells(n);
+			parallelFor(n, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++) cells[i] = cellOf(points[i], cellSize);
+			});
+
+			//cell ids in first seen order, then a counting sort: each cell owns a contiguous range of point indices in ascending order
+			FlatTable<Cell, CellHash> table(n);
+			std::vector<size_t> cellOfPoint(n);
+			std::vector<size_t> cellStart;
+			for (size_t i = 0; i < n; i++) {
+				cellOfPoint[i] = table.insert(cells[i], cellStart.size());
+				if (cellOfPoint[i] == cellStart.size()) cellStart.push_back(0);
+				cellStart[cellOfPoint[i]]++;
+			}
+			size_t noCells = cellStart.size();
+			cellStart.push_back(0);
+			size_t total = 0;
+			for (size_t c = 0; c <= noCells; c++) {
+				size_t count = cellStart[c];
+				cellStart[c] = total;
+				total += count;
+			}
+			std::vector<size_t> byCell(n);
+			std::vector<size_t> fill(cellStart.begin(), cellStart.end() - 1);
+			for (size_t i = 0; i < n; i++) byCell[fill[cellOfPoint[i]]++] = i;
+
+			std::vector<size_t> canonical(n);
+			parallelFor(n, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++) {
+					const std::array<double, 3>& p = points[i];
+					Cell from = cellOf({ p[0] - tolerance, p[1] - tolerance, p[2] - tolerance }, cellSize);
+					Cell to = cellOf({ p[0] + tolerance, p[1] + tolerance, p[2] + tolerance }, cellSize);
+					size_t lowest = i;
+					for (int64_t x = from[0]; x <= to[0]; x++) {
+						for (int64_t y = from[1]; y <= to[1]; y++) {
+							for (int64_t z = from[2]; z <= to[2]; z++) {
+								size_t c = table.find(Cell{ x, y, z });
+								if (c == SIZE_MAX) continue;
+								for (size_t k = cellStart[c]; k < cellStart[c + 1]; k++) {
+									size_t j = byCell[k];
+									if (j >= lowest) break; //ranges are sorted by index
+									const std::array<double, 3>& q = points[j];
+									if (std::abs(p[0] - q[0]) <= tolerance && std::abs(p[1] - q[1]) <= tolerance && std::abs(p[2] - q[2]) <= tolerance) lowest = j;
+								}
+							}
+						}
+					}
+					canonical[i] = lowest;
+				}
+			});
+
+			//canonical[i] <= i, so one ascending pass resolves chains
+			for (size_t i = 0; i < n; i++) canonical[i] = canonical[canonical[i]];
+			return canonical;
+		}
+
+		//Element identity independent of direction: end nodes as (min, max), section SIZE_MAX when sections are not compared
+		struct ElementKey {
+			size_t low, high, section;
+
+			ElementKey() : low(0), high(0), section(SIZE_MAX) {}
+			ElementKey(size_t node1, size_t node2, size_t sectionId) : low(std::min(node1, node2)), high(std::max(node1, node2)), section(sectionId) {}
+
+			bool operator==(const ElementKey& other) const {
+				return low == other.low && high == other.high && section == other.section;
+			}
+			bool operator<(const ElementKey& other) const {
+				if (low != other.low) return low < other.low;
+				if (high != other.high) return high < other.high;
+				return section < other.section;
+			}
+		};
+
+		struct ElementKeyHash {
+			size_t operator()(const ElementKey& k) const {
+				return (size_t)mix((uint64_t)k.low * 0x9E3779B97F4A7C15ull ^ (uint64_t)k.high * 0xC2B2AE3D27D4EB4Full ^ (uint64_t)k.section * 0x165667B19E3779F9ull);
+			}
+		};
+
+		//Indices with equal keys, only groups of 2 or more. Each group is ascending and the groups are ordered by their first index,
+		//so group[0] is the one to keep.
+		static inline std::vector<std::vector<size_t>> groupKeys(const std::vector<ElementKey>& keys) {
+			FlatTable<ElementKey, ElementKeyHash> table(keys.size());
+			std::vector<size_t> firstOf(keys.size());
+			std::vector<size_t> groupOf(keys.size(), SIZE_MAX);
+			std::vector<std::vector<size_t>> groups;
+			for (size_t i = 0; i < keys.size(); i++) {
+				size_t first = table.insert(keys[i], i);
+				if (first == i) continue;
+				if (groupOf[first] == SIZE_MAX) {
+					groupOf[first] = groups.size();
+					groups.push_back({ first });
+				}
+				groups[groupOf[first]].push_back(i);
+			}
+			std::sort(groups.begin(), groups.end(), [](const std::vector<size_t>& a, const std::vector<size_t>& b) {return a[0] < b[0]; });
+			return groups;
+		}
+
+		//Same result as groupKeys from a parallel sort: blocks are sorted on the threads, then merged pairwise in parallel rounds.
+		//Uses no hash table, so memory access stays sequential for very large element sets.
+		template <typename ParallelFor>
+		std::vector<std::vector<size_t>> groupKeysSorted(const std::vector<ElementKey>& keys, ParallelFor parallelFor) {
+			size_t n = keys.size();
+			std::vector<size_t> order(n);
+			std::iota(order.begin(), order.end(), 0);
+			auto less = [&](size_t a, size_t b) {return (keys[a] == keys[b]) ? a < b : keys[a] < keys[b]; };
+
+			const size_t blockSize = 1 << 16;
+			size_t noBlocks = (n + blockSize - 1) / blockSize;
+			parallelFor(noBlocks, [&](size_t begin, size_t end) {
+				for (size_t b = begin; b < end; b++) std::sort(order.begin() + b * blockSize, order.begin() + std::min(n, (b + 1) * blockSize), less);
+			});
+			for (size_t width = blockSize; width < n; width *= 2) {
+				size_t noPairs = (n + 2 * width - 1) / (2 * width);
+				parallelFor(noPairs, [&](size_t begin, size_t end) {
+					for (size_t pair = begin; pair < end; pair++) {
+						size_t first = pair * 2 * width;
+						size_t middle = std::min(n, first + width), last = std::min(n, first + 2 * width);
+						std::inplace_merge(order.begin() + first, order.begin() + middle, order.begin() + last, less);
+					}
+				});
+			}
+
+			std::vector<std::vector<size_t>> groups;
+			for (size_t k = 0; k < n;) {
+				size_t end = k + 1;
+				while (end < n && keys[order[end]] == keys[order[k]]) end++;
+				if (end - k > 1) groups.emplace_back(order.begin() + k, order.begin() + end);
+				k = end;
+			}
+			std::sort(groups.begin(), groups.end(), [](const std::vector<size_t>& a, const std::vector<size_t>& b) {return a[0] < b[0]; });
+			return groups;
+		}
+	}
+}
@@ -0,0 +1,231 @@
+#pragma once
+#include "VBeams.h"
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+//Structure of arrays copy of the elements: node positions, section ids, lengths, direction cosines and the length scaled
+//stiffness coefficients each in their own contiguous array, so lengths, local frames and coefficients can be computed
+//for 4 (AVX2) or 8 (AVX-512) elements at a time. The vector paths are compiled in with /arch:AVX2 or /arch:AVX512
+//(-mavx2 / -mavx512f), otherwise only the scalar path exists.
+namespace Beams {
+
+	enum class KernelPath {
+		Scalar = 1,
+		AVX2 = 4,
+		AVX512 = 8
+	};
+
+	namespace Simd {
+
+		//All lane types have the same static interface, so one kernel template serves every width
+		struct Scalar {
+			typedef double V;
+			static const size_t width = 1;
+			static V load(const double* p) { return *p; }
+			static void store(double* p, V v) { *p = v; }
+			static V set1(double d) { return d; }
+			static V add(V a, V b) { return a + b; }
+			static V sub(V a, V b) { return a - b; }
+			static V mul(V a, V b) { return a * b; }
+			static V div(V a, V b) { return a / b; }
+			static V sqrt(V a) { return std::sqrt(a); }
+		};
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+		struct Avx2 {
+			typedef __m256d V;
+			static const size_t width = 4;
+			static V load(const double* p) { return _mm256_loadu_pd(p); }
+			static void store(double* p, V v) { _mm256_storeu_pd(p, v); }
+			static V set1(double d) { return _mm256_set1_pd(d); }
+			static V add(V a, V b) { return _mm256_add_pd(a, b); }
+			static V sub(V a, V b) { return _mm256_sub_pd(a, b); }
+			static V mul(V a, V b) { return _mm256_mul_pd(a, b); }
+			static V div(V a, V b) { return _mm256_div_pd(a, b); }
+			static V sqrt(V a) { return _mm256_sqrt_pd(a); }
+		};
+#endif
+
+#if defined(__AVX512F__)
+		struct Avx512 {
+			typedef __m512d V;
+			static const size_t width = 8;
+			static V load(const double* p) { return _mm512_loadu_pd(p); }
+			static void store(double* p, V v) { _mm512_storeu_pd(p, v); }
+			static V set1(double d) { return _mm512_set1_pd(d); }
+			static V add(V a, V b) { return _mm512_add_pd(a, b); }
+			static V sub(V a, V b) { return _mm512_sub_pd(a, b); }
+			static V mul(V a, V b) { return _mm512_mul_pd(a, b); }
+			static V div(V a, V b) { return _mm512_div_pd(a, b); }
+			static V sqrt(V a) { return _mm512_sqrt_pd(a); }
+		};
+#endif
+
+		//Lanes filled one by one from f(lane), for the node and section lookups
+		template <typename S, typename F>
+		static inline typename S::V gather(F f) {
+			double lanes[S::width];
+			for (size_t l = 0; l < S::width; l++) lanes[l] = f(l);
+			return S::load(lanes);
+		}
+	}
+
+	class ElementStore {
+	public:
+		//order of the coefficient arrays, same as the arguments of fillLocalStiffness
+		enum Coefficient { K1, K2, EIz12, EIy12, EIz6, EIy6, EIz4, EIy4, EIz2, EIy2, NO_COEFFICIENTS };
+
+	private:
+		std::vector<size_t> node1Pos, node2Pos, node3Pos;
+		std::vector<size_t> sectionId;
+		std::vector<double> length;
+		std::array<std::vector<double>, 9> cosines; //cosines[3 * c + r] = dirCosines(r, c), component r of local axis c
+		std::array<std::vector<double>, NO_COEFFICIENTS> coefficients;
+
+		//per section id: the section terms that are divided by L, L^2 or L^3
+		std::vector<std::array<double, NO_COEFFICIENTS>> sectionTerms;
+
+		//Elements [first, first + S::width)
+		template <typename S>
+		void computeBatch(size_t first, const NodeContainer& nodes) {
+			typedef typename S::V V;
+			auto coordinate = [&](const std::vector<size_t>& nodePos, int axis) {
+				return Simd::gather<S>([&](size_t l) {
+					const Node& node = nodes.get_byPos(nodePos[first + l]);
+					return (axis == 0) ? node.x : (axis == 1) ? node.y : node.z;
+				});
+			};
+			V x1 = coordinate(node1Pos, 0), y1 = coordinate(node1Pos, 1), z1 = coordinate(node1Pos, 2);
+
+			//local x along the element
+			V dx = S::sub(coordinate(node2Pos, 0), x1), dy = S::sub(coordinate(node2Pos, 1), y1), dz = S::sub(coordinate(node2Pos, 2), z1);
+			V len = S::sqrt(S::add(S::add(S::mul(dx, dx), S::mul(dy, dy)), S::mul(dz, dz)));
+			V invLen = S::div(S::set1(1), len);
+			V ex = S::mul(dx, invLen), ey = S::mul(dy, invLen), ez = S::mul(dz, invLen);
+
+			//local y: node 3 direction without its x component
+			V vx = S::sub(coordinate(node3Pos, 0), x1), vy = S::sub(coordinate(node3Pos, 1), y1), vz = S::sub(coordinate(node3Pos, 2), z1);
+			V dot = S::add(S::add(S::mul(vx, ex), S::mul(vy, ey)), S::mul(vz, ez));
+			vx = S::sub(vx, S::mul(dot, ex));
+			vy = S::sub(vy, S::mul(dot, ey));
+			vz = S::sub(vz, S::mul(dot, ez));
+			V invNorm = S::div(S::set1(1), S::sqrt(S::add(S::add(S::mul(vx, vx), S::mul(vy, vy)), S::mul(vz, vz))));
+			vx = S::mul(vx, invNorm);
+			vy = S::mul(vy, invNorm);
+			vz = S::mul(vz, invNorm);
+
+			//local z = x cross y
+			V wx = S::sub(S::mul(ey, vz), S::mul(ez, vy));
+			V wy = S::sub(S::mul(ez, vx), S::mul(ex, vz));
+			V wz = S::sub(S::mul(ex, vy), S::mul(ey, vx));
+
+			S::store(&length[first], len);
+			const V axes[9] = { ex, ey, ez, vx, vy, vz, wx, wy, wz };
+			for (int k = 0; k < 9; k++) S::store(&cosines[k][first], axes[k]);
+
+			V invLenSq = S::mul(invLen, invLen);
+			V invLenCb = S::mul(invLenSq, invLen);
+			for (int c = 0; c < NO_COEFFICIENTS; c++) {
+				V term = Simd::gather<S>([&](size_t l) {return sectionTerms[sectionId[first + l]][c]; });
+				V scale = (c == EIz12 || c == EIy12) ? invLenCb : (c == EIz6 || c == EIy6) ? invLenSq : invLen;
+				S::store(&coefficients[c][first], S::mul(term, scale));
+			}
+		}
+
+		template <typename S>
+		void computeRange(size_t begin, size_t end, const NodeContainer& nodes) {
+			size_t i = begin;
+			for (; i + S::width <= end; i += S::width) computeBatch<S>(i, nodes);
+			for (; i < end; i++) computeBatch<Simd::Scalar>(i, nodes); //tail
+		}
+
+	public:
+		//Widest path compiled in
+		static KernelPath widestPath() {
+#if defined(__AVX512F__)
+			return KernelPath::AVX512;
+#elif defined(__AVX2__)
+			return KernelPath::AVX2;
+#else
+			return KernelPath::Scalar;
+#endif
+		}
+
+		size_t size() const {
+			return length.size();
+		}
+
+		//Copies the connectivity. Lengths, frames and coefficients are undefined until update
+		void assign(const std::vector<vBeam>& elements) {
+			size_t n = elements.size();
+			node1Pos.resize(n);
+			node2Pos.resize(n);
+			node3Pos.resize(n);
+			sectionId.resize(n);
+			for (size_t i = 0; i < n; i++) {
+				node1Pos[i] = elements[i].node1Pos;
+				node2Pos[i] = elements[i].node2Pos;
+				node3Pos[i] = elements[i].node3Pos;
+				sectionId[i] = elements[i].getSectionId();
+			}
+			length.resize(n);
+			for (auto& array : cosines) array.resize(n);
+			for (auto& array : coefficients) array.resize(n);
+		}
+
+		//Lengths, local frames and stiffness coefficients of all elements. A path that is not compiled in falls back to the widest one that is.
+		void update(const NodeContainer& nodes, const std::map<size_t, Section>& sections, unsigned noThreads = 1, KernelPath path = widestPath()) {
+			sectionTerms.assign(sections.empty() ? 0 : sections.rbegin()->first + 1, std::array<double, NO_COEFFICIENTS>{});
+			for (auto& secPair : sections) {
+				const Section& sec = secPair.second;
+				sectionTerms[secPair.first] = { sec.Modulus * sec.Area, sec.Ixx * sec.G, sec.EIz12, sec.EIy12, sec.EIz6, sec.EIy6, sec.EIz4, sec.EIy4, sec.EIz2, sec.EIy2 };
+			}
+			if ((int)path > (int)widestPath()) path = widestPath();
+
+			//chunks of whole batches, so only the last chunk has a scalar tail
+			const size_t batch = 64;
+			size_t n = size();
+			parallelFor((n + batch - 1) / batch, noThreads, [&](size_t begin, size_t end) {
+				size_t first = begin * batch, last = std::min(n, end * batch);
+				switch (path) {
+#if defined(__AVX512F__)
+				case KernelPath::AVX512: computeRange<Simd::Avx512>(first, last, nodes); break;
+#endif
+#if defined(__AVX2__) || defined(__AVX512F__)
+				case KernelPath::AVX2: computeRange<Simd::Avx2>(first, last, nodes); break;
+#endif
+				default: computeRange<Simd::Scalar>(first, last, nodes); break;
+				}
+			});
+		}
+
+		double getLength(size_t i) const {
+			return length[i];
+		}
+
+		Eigen::Matrix3d getDirCosines(size_t i) const {
+			Eigen::Matrix3d R;
+			for (int c = 0; c < 3; c++) {
+				for (int r = 0; r < 3; r++) R(r, c) = cosines[3 * c + r][i];
+			}
+			return R;
+		}
+
+		double getCoefficient(size_t i, Coefficient c) const {
+			return coefficients[c][i];
+		}
+
+		void calc_LocalStiffness(size_t i, Matrix12d& K) const {
+			K.setZero();
+			fillLocalStiffness(K, coefficients[K1][i], coefficients[K2][i], coefficients[EIz12][i], coefficients[EIy12][i], coefficients[EIz6][i],
+				coefficients[EIy6][i], coefficients[EIz4][i], coefficients[EIy4][i], coefficients[EIz2][i], coefficients[EIy2][i]);
+		}
+
+		void calc_GlobalStiffness(size_t i, Matrix12d& globalB) const {
+			Matrix12d K;
+			calc_LocalStiffness(i, K);
+			rotateToGlobal(getDirCosines(i), K, globalB);
+		}
+	};
+}
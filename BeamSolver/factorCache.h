@@ -0,0 +1,309 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <atomic>
+#include <random>
+#include <chrono>
+#include <Eigen/SparseCore>
+#include "ordering.h"
+#include "duplicates.h"
+
+//On-disk cache of LDLT factors of the reduced K. Files are named after a hash of everything K depends on, so a later session
+//with the same stiffness reads the factor instead of computing it. The node numbering the factor was computed in is stored
+//with it. The directory is kept under a size cap by removing the least recently used files (a hit touches its file).
+namespace Beams {
+
+	//Incremental 64 bit hash. Depends on the values only, so it is the same in every session on the same platform.
+	class StableHash {
+		uint64_t h = 0x9E3779B97F4A7C15ull;
+
+	public:
+		void add(uint64_t v) {
+			h = Duplicates::mix(h ^ (v + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2)));
+		}
+
+		//-0 and 0 give the same K
+		void add(double d) {
+			if (d == 0) d = 0;
+			uint64_t bits;
+			std::memcpy(&bits, &d, sizeof(bits));
+			add(bits);
+		}
+
+		//whole 8 byte words, the tail padded with zeros
+		void addBytes(const void* data, size_t bytes) {
+			const char* p = (const char*)data;
+			for (; bytes >= 8; bytes -= 8, p += 8) {
+				uint64_t word;
+				std::memcpy(&word, p, 8);
+				add(word);
+			}
+			if (bytes) {
+				uint64_t word = 0;
+				std::memcpy(&word, p, bytes);
+				add(word);
+			}
+		}
+
+		uint64_t value() const {
+			return h;
+		}
+	};
+
+	struct FactorCacheStats {
+		size_t lookups = 0;   //factorizations with the cache on
+		size_t hits = 0;      //factors read instead of computed
+		size_t stores = 0;    //factors written
+		size_t evictions = 0; //files removed to stay under the size cap
+
+		double hitRate() const {
+			return lookups ? (double)hits / lookups : 0.;
+		}
+	};
+
+	//A factor as read back: L strictly lower (the unit diagonal is not stored), D and the numbering it belongs to
+	struct CachedFactor {
+		std::vector<size_t> nodeOrder; //node positions in matrix order
+		OrderingStats orderingBefore, orderingAfter;
+		Eigen::SparseMatrix<double> L;
+		Eigen::VectorXd D;
+	};
+
+	class FactorCache {
+	public:
+		typedef Eigen::SparseMatrix<double>::StorageIndex StorageIndex;
+
+	private:
+		static constexpr char MAGIC[8] = { 'V','B','E','A','M','f','1','\0' };
+		static const uint32_t VERSION = 1;
+
+		struct FileHeader {
+			char magic[8];
+			uint32_t version;
+			uint32_t indexBytes; //sizeof(StorageIndex) of the writer
+			uint64_t key;
+			uint64_t noNodes;
+			uint64_t noEquations;
+			uint64_t nonZeros;
+			uint64_t stats[8]; //orderingBefore, orderingAfter
+			uint64_t payloadChecksum;
+		};
+		static_assert(sizeof(FileHeader) == 120, "FileHeader layout");
+
+		std::filesystem::path directory; //empty: cache off
+		uintmax_t maxBytes = 0;
+		FactorCacheStats stats;
+
+		static void packStats(const OrderingStats& s, uint64_t* out) {
+			out[0] = s.bandwidth;
+			out[1] = s.profile;
+			out[2] = s.factorNonZeros;
+			out[3] = s.fillIn;
+		}
+
+		static OrderingStats unpackStats(const uint64_t* in) {
+			OrderingStats s;
+			s.bandwidth = (size_t)in[0];
+			s.profile = (size_t)in[1];
+			s.factorNonZeros = (size_t)in[2];
+			s.fillIn = (size_t)in[3];
+			return s;
+		}
+
+		static uintmax_t fileSize(uint64_t noNodes, uint64_t noEquations, uint64_t nonZeros) {
+			return sizeof(FileHeader) + noNodes * sizeof(uint64_t) + (noEquations + 1 + nonZeros) * sizeof(StorageIndex)
+				+ (nonZeros + noEquations) * sizeof(double);
+		}
+
+		//Removes the oldest factor files until the directory holds at most maxBytes. keep is never removed.
+		void evict(const std::filesystem::path& keep) {
+			struct Entry {
+				std::filesystem::file_time_type used;
+				uintmax_t bytes;
+				std::filesystem::path path;
+			};
+			std::vector<Entry> entries;
+			uintmax_t total = 0;
+			std::error_code error;
+			for (auto& item : std::filesystem::directory_iterator(directory, error)) {
+				if (!item.is_regular_file(error) || item.path().extension() != ".vbfac") continue;
+				Entry entry{ item.last_write_time(error), item.file_size(error), item.path() };
+				if (error) continue;
+				total += entry.bytes;
+				if (entry.path != keep) entries.push_back(entry);
+			}
+			std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {return a.used < b.used; });
+			for (auto& entry : entries) {
+				if (total <= maxBytes) break;
+				if (std::filesystem::remove(entry.path, error)) {
+					total -= entry.bytes;
+					stats.evictions++;
+				}
+			}
+		}
+
+		//<key>.<random>.tmp, every store gets its own, so concurrent writers of the same key do not share a file
+		static std::filesystem::path temporaryName(const std::filesystem::path& path) {
+			static std::atomic<uint64_t> counter{ 0 };
+			static const uint64_t session = ((uint64_t)std::random_device()() << 32) ^ std::random_device()();
+			StableHash suffix;
+			suffix.add(session);
+			suffix.add((uint64_t)std::chrono::steady_clock::now().time_since_epoch().count());
+			suffix.add(counter++);
+			char name[24];
+			snprintf(name, sizeof(name), ".%016llx", (unsigned long long)suffix.value());
+			std::filesystem::path temporary = path;
+			temporary.replace_extension(std::string(name) + ".tmp");
+			return temporary;
+		}
+
+	public:
+		//Factors are kept in directory (created if missing), at most maxBytes in total. An empty directory turns the cache off.
+		void configure(const std::string& cacheDirectory, uintmax_t cacheMaxBytes) {
+			directory = cacheDirectory;
+			maxBytes = cacheMaxBytes;
+			if (directory.empty()) return;
+			std::error_code error;
+			std::filesystem::create_directories(directory, error);
+			evict(std::filesystem::path());
+		}
+
+		bool isEnabled() const {
+			return !directory.empty();
+		}
+
+		const std::filesystem::path& getDirectory() const {
+			return directory;
+		}
+
+		uintmax_t getMaxBytes() const {
+			return maxBytes;
+		}
+
+		std::filesystem::path fileName(uint64_t key) const {
+			char name[24];
+			snprintf(name, sizeof(name), "%016llx", (unsigned long long)key);
+			return directory / (std::string(name) + ".vbfac");
+		}
+
+		//Reads the factor stored for key. False if there is none or the file does not check out, factor is undefined then.
+		bool load(uint64_t key, CachedFactor& factor) {
+			if (!isEnabled()) return false;
+			stats.lookups++;
+			std::filesystem::path path = fileName(key);
+			std::ifstream in(path, std::ios_base::binary);
+			if (!in) return false;
+
+			FileHeader header;
+			if (!in.read((char*)&header, sizeof(header))) return false;
+			if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) || header.version != VERSION || header.indexBytes != sizeof(StorageIndex) || header.key != key) return false;
+			std::error_code error;
+			if (std::filesystem::file_size(path, error) != fileSize(header.noNodes, header.noEquations, header.nonZeros) || error) return false;
+
+			Eigen::Index n = (Eigen::Index)header.noEquations;
+			std::vector<uint64_t> order(header.noNodes);
+			factor.L.resize(n, n);
+			factor.L.resizeNonZeros((Eigen::Index)header.nonZeros);
+			factor.D.resize(n);
+			in.read((char*)order.data(), order.size() * sizeof(uint64_t));
+			in.read((char*)factor.L.outerIndexPtr(), (n + 1) * sizeof(StorageIndex));
+			in.read((char*)factor.L.innerIndexPtr(), header.nonZeros * sizeof(StorageIndex));
+			in.read((char*)factor.L.valuePtr(), header.nonZeros * sizeof(double));
+			in.read((char*)factor.D.data(), n * sizeof(double));
+			if (!in) return false;
+
+			StableHash checksum;
+			checksum.addBytes(order.data(), order.size() * sizeof(uint64_t));
+			checksum.addBytes(factor.L.outerIndexPtr(), (n + 1) * sizeof(StorageIndex));
+			checksum.addBytes(factor.L.innerIndexPtr(), header.nonZeros * sizeof(StorageIndex));
+			checksum.addBytes(factor.L.valuePtr(), header.nonZeros * sizeof(double));
+			checksum.addBytes(factor.D.data(), n * sizeof(double));
+			if (checksum.value() != header.payloadChecksum) return false;
+
+			//the substitutions index with these, so they are checked like any other input
+			const StorageIndex* outer = factor.L.outerIndexPtr();
+			const StorageIndex* inner = factor.L.innerIndexPtr();
+			if (outer[0] != 0 || (uint64_t)outer[n] != header.nonZeros) return false;
+			for (Eigen::Index j = 0; j < n; j++) {
+				if (outer[j] > outer[j + 1]) return false;
+				for (StorageIndex k = outer[j]; k < outer[j + 1]; k++) {
+					if (inner[k] < 0 || inner[k] >= n) return false;
+				}
+			}
+
+			factor.nodeOrder.assign(order.begin(), order.end());
+			factor.orderingBefore = unpackStats(header.stats);
+			factor.orderingAfter = unpackStats(header.stats + 4);
+			in.close();
+			std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error); //most recently used
+			stats.hits++;
+			return true;
+		}
+
+		//Writes the factor of key. Written to a temporary file of this writer and renamed, so other sessions never read a partial file.
+		//A factor bigger than the whole cache is not stored.
+		bool store(uint64_t key, const std::vector<size_t>& nodeOrder, const OrderingStats& orderingBefore, const OrderingStats& orderingAfter,
+			const Eigen::SparseMatrix<double>& L, const Eigen::VectorXd& D) {
+			if (!isEnabled() || !L.isCompressed() || L.rows() != D.size()) return false;
+			uint64_t n = (uint64_t)L.rows(), nonZeros = (uint64_t)L.nonZeros();
+			if (fileSize(nodeOrder.size(), n, nonZeros) > maxBytes) return false;
+
+			FileHeader header{};
+			std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+			header.version = VERSION;
+			header.indexBytes = sizeof(StorageIndex);
+			header.key = key;
+			header.noNodes = nodeOrder.size();
+			header.noEquations = n;
+			header.nonZeros = nonZeros;
+			packStats(orderingBefore, header.stats);
+			packStats(orderingAfter, header.stats + 4);
+
+			std::vector<uint64_t> order(nodeOrder.begin(), nodeOrder.end());
+			StableHash checksum;
+			checksum.addBytes(order.data(), order.size() * sizeof(uint64_t));
+			checksum.addBytes(L.outerIndexPtr(), (n + 1) * sizeof(StorageIndex));
+			checksum.addBytes(L.innerIndexPtr(), nonZeros * sizeof(StorageIndex));
+			checksum.addBytes(L.valuePtr(), nonZeros * sizeof(double));
+			checksum.addBytes(D.data(), n * sizeof(double));
+			header.payloadChecksum = checksum.value();
+
+			std::filesystem::path path = fileName(key);
+			std::filesystem::path temporary = temporaryName(path);
+			{
+				std::ofstream out(temporary, std::ios_base::binary);
+				out.write((const char*)&header, sizeof(header));
+				out.write((const char*)order.data(), order.size() * sizeof(uint64_t));
+				out.write((const char*)L.outerIndexPtr(), (n + 1) * sizeof(StorageIndex));
+				out.write((const char*)L.innerIndexPtr(), nonZeros * sizeof(StorageIndex));
+				out.write((const char*)L.valuePtr(), nonZeros * sizeof(double));
+				out.write((const char*)D.data(), n * sizeof(double));
+				if (!out.flush()) {
+					out.close();
+					std::error_code error;
+					std::filesystem::remove(temporary, error);
+					return false;
+				}
+			}
+			std::error_code error;
+			std::filesystem::rename(temporary, path, error);
+			if (error) {
+				std::filesystem::remove(temporary, error);
+				return false;
+			}
+			stats.stores++;
+			evict(path);
+			return true;
+		}
+
+		const FactorCacheStats& getStats() const {
+			return stats;
+		}
+	};
+}
@@ -0,0 +1,199 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include <Eigen/SparseCore>
+#include <Eigen/Dense>
+
+//Preconditioned conjugate gradients for the reduced K. The operator is passed in, so K does not have to be assembled.
+namespace Beams {
+
+	enum class SolverMode {
+		Direct,   //sparse LDLT/LU factorization, reused while K does not change
+		Iterative //PCG, memory linear in the element count
+	};
+
+	enum class Preconditioner {
+		None,
+		BlockJacobi, //inverse of the 6x6 diagonal block of every node
+		IC0          //incomplete Cholesky on the pattern of the assembled K, no fill
+	};
+
+	struct PCGSettings {
+		Preconditioner preconditioner = Preconditioner::BlockJacobi;
+		double tolerance = 1e-10; //on ||r|| / ||b||
+		size_t maxIterations = 10000;
+		bool warmStart = true; //start from the last result of the load case if the dof numbering did not change
+	};
+
+	struct PCGReport {
+		size_t iterations = 0;
+		double relativeResidual = 0;
+		bool converged = false;
+	};
+
+	//Inverted 6x6 diagonal blocks of K. eqs holds 6 reduced equations per node, -1 for constrained dofs.
+	class BlockJacobi {
+		std::vector<Eigen::Matrix<double, 6, 6>> inverse;
+		std::vector<Eigen::Index> eqs;
+
+	public:
+		//blocks are the full (unreduced) node blocks, constrained rows/columns are replaced by identity before inverting
+		void compute(std::vector<Eigen::Matrix<double, 6, 6>>& blocks, std::vector<Eigen::Index>&& nodeEqs) {
+			eqs = std::move(nodeEqs);
+			inverse.resize(blocks.size());
+			for (size_t n = 0; n < blocks.size(); n++) {
+				Eigen::Matrix<double, 6, 6>& block = blocks[n];
+				for (int d = 0; d < 6; d++) {
+					if (eqs[6 * n + d] >= 0) continue;
+					block.row(d).setZero();
+					block.col(d).setZero();
+					block(d, d) = 1;
+				}
+				Eigen::LDLT<Eigen::Matrix<double, 6, 6>> blockLDLT(block);
+				if (blockLDLT.info() == Eigen::Success && blockLDLT.isPositive()) inverse[n] = blockLDLT.solve(Eigen::Matrix<double, 6, 6>::Identity());
+				else inverse[n] = block.diagonal().cwiseAbs().cwiseMax(1e-300).cwiseInverse().asDiagonal(); //singular block, plain Jacobi
+			}
+		}
+
+		void apply(const Eigen::VectorXd& r, Eigen::VectorXd& z) const {
+			z.resize(r.size());
+			Eigen::Matrix<double, 6, 1> rNode;
+			for (size_t n = 0; n < inverse.size(); n++) {
+				const Eigen::Index* nodeEqs = eqs.data() + 6 * n;
+				for (int d = 0; d < 6; d++) rNode(d) = (nodeEqs[d] >= 0) ? r(nodeEqs[d]) : 0.;
+				Eigen::Matrix<double, 6, 1> zNode = inverse[n] * rNode;
+				for (int d = 0; d < 6; d++) {
+					if (nodeEqs[d] >= 0) z(nodeEqs[d]) = zNode(d);
+				}
+			}
+		}
+	};
+
+	//IC(0): Cholesky factor restricted to the pattern of the lower triangle of K. If a pivot breaks down the factorization
+	//is retried on K + shift*diag(K) with a growing shift.
+	class IncompleteCholesky0 {
+		Eigen::SparseMatrix<double> L;
+		double shift = 0;
+
+		bool factorize(const Eigen::SparseMatrix<double>& lower, double diagonalShift) {
+			L = lower;
+			const int* outer = L.outerIndexPtr();
+			const int* inner = L.innerIndexPtr();
+			double* val = L.valuePtr();
+			Eigen::Index n = L.cols();
+
+			//K + shift*diag(K), before any update reaches the pivots
+			for (Eigen::Index k = 0; k < n; k++) {
+				int p0 = outer[k];
+				if (p0 == outer[k + 1] || inner[p0] != k) return false; //rows are sorted, the diagonal comes first
+				val[p0] *= 1 + diagonalShift;
+			}
+
+			for (Eigen::Index k = 0; k < n; k++) {
+				int p0 = outer[k];
+				double pivot = val[p0];
+				if (!(pivot > 0)) return false;
+				pivot = std::sqrt(pivot);
+				val[p0] = pivot;
+				for (int p = p0 + 1; p < outer[k + 1]; p++) val[p] /= pivot;
+
+				//right looking update of the columns j below k, only on entries that exist
+				for (int p = p0 + 1; p < outer[k + 1]; p++) {
+					Eigen::Index j = inner[p];
+					double ljk = val[p];
+					int t = outer[j];
+					for (int q = p; q < outer[k + 1]; q++) {
+						while (t < outer[j + 1] && inner[t] < inner[q]) t++;
+						if (t == outer[j + 1]) break;
+						if (inner[t] == inner[q]) val[t] -= val[q] * ljk;
+					}
+				}
+			}
+			return true;
+		}
+
+	public:
+		//lower: lower triangle of the reduced K in column major order
+		bool compute(const Eigen::SparseMatrix<double>& lower) {
+			shift = 0;
+			for (int attempt = 0; attempt < 12; attempt++) {
+				if (factorize(lower, shift)) return true;
+				shift = (shift == 0) ? 1e-3 : shift * 4;
+			}
+			L.resize(0, 0);
+			return false;
+		}
+
+		double getShift() const {
+			return shift;
+		}
+
+		//lower triangle, diagonal first in every column
+		const Eigen::SparseMatrix<double>& getFactor() const {
+			return L;
+		}
+
+		//z = (L L^T)^-1 r
+		void apply(const Eigen::VectorXd& r, Eigen::VectorXd& z) const {
+			z = r;
+			const int* outer = L.outerIndexPtr();
+			const int* inner = L.innerIndexPtr();
+			const double* val = L.valuePtr();
+			Eigen::Index n = L.cols();
+			for (Eigen::Index k = 0; k < n; k++) {
+				z(k) /= val[outer[k]];
+				for (int p = outer[k] + 1; p < outer[k + 1]; p++) z(inner[p]) -= val[p] * z(k);
+			}
+			for (Eigen::Index k = n - 1; k >= 0; k--) {
+				for (int p = outer[k] + 1; p < outer[k + 1]; p++) z(k) -= val[p] * z(inner[p]);
+				z(k) /= val[outer[k]];
+			}
+		}
+	};
+
+	//Solves A x = b. x holds the start vector. applyA(x, y) sets y = A x, applyM(r, z) sets z = M^-1 r.
+	template <typename ApplyA, typename ApplyM>
+	PCGReport conjugateGradient(const ApplyA& applyA, const ApplyM& applyM, const Eigen::VectorXd& b, Eigen::VectorXd& x, double tolerance, size_t maxIterations) {
+		PCGReport report;
+		double bNorm = b.norm();
+		if (bNorm == 0) {
+			x.setZero();
+			report.converged = true;
+			return report;
+		}
+
+		Eigen::VectorXd r(b.size()), z, p, q(b.size());
+		applyA(x, q);
+		r = b - q;
+		report.relativeResidual = r.norm() / bNorm;
+		if (report.relativeResidual <= tolerance) {
+			report.converged = true;
+			return report;
+		}
+
+		applyM(r, z);
+		p = z;
+		double rz = r.dot(z);
+		while (report.iterations < maxIterations) {
+			applyA(p, q);
+			double pq = p.dot(q);
+			if (!(pq > 0)) break; //K not positive definite on p, the model is a mechanism
+			double alpha = rz / pq;
+			x += alpha * p;
+			r -= alpha * q;
+			report.iterations++;
+
+			report.relativeResidual = r.norm() / bNorm;
+			if (report.relativeResidual <= tolerance) {
+				report.converged = true;
+				break;
+			}
+
+			applyM(r, z);
+			double rzNew = r.dot(z);
+			p = z + (rzNew / rz) * p;
+			rz = rzNew;
+		}
+		return report;
+	}
+}
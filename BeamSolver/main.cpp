@@ -4,9 +4,15 @@
 #include <iostream>
 #include "drawing.h"
 #include "VBeams.h"
+#include "benchmarks.h"
+
+//#define RUN_BENCHMARKS
 
 int main()
 {
+#ifdef RUN_BENCHMARKS
+    return Benchmarks::runAll() ? 0 : 1;
+#endif
 
     
     Beams::Model model1;
@@ -0,0 +1,41 @@
+#include "mappedFile.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOGDI
+#define NOUSER
+#define NOMINMAX
+#include <windows.h>
+#include <filesystem>
+
+namespace Saving {
+	namespace Windows {
+
+		const uint8_t* mapFile(const std::string& fname, size_t& length) {
+			length = 0;
+			//same narrow to wide conversion as the std::ifstream the other formats are read with
+			HANDLE file = CreateFileW(std::filesystem::path(fname).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+				FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			if (file == INVALID_HANDLE_VALUE) return nullptr;
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(file, &size) || size.QuadPart == 0 || (unsigned long long)size.QuadPart > SIZE_MAX) {
+				CloseHandle(file);
+				return nullptr;
+			}
+			//the view keeps the mapping and the file open, both handles can go
+			HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			CloseHandle(file);
+			if (!mapping) return nullptr;
+			void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(mapping);
+			if (!view) return nullptr;
+			length = (size_t)size.QuadPart;
+			return static_cast<const uint8_t*>(view);
+		}
+
+		void unmapFile(const uint8_t* view) {
+			if (view) UnmapViewOfFile(view);
+		}
+	}
+}
+#endif
@@ -0,0 +1,17 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+//Read only mapping of a whole file through the Win32 API. Implemented in mappedFile.cpp, the only file that includes windows.h,
+//so its names never meet raylib's. POSIX maps the file in saveFile.h directly.
+namespace Saving {
+	namespace Windows {
+
+		//View of the whole of fname, length set to its size. nullptr if it cannot be opened or is empty.
+		const uint8_t* mapFile(const std::string& fname, size_t& length);
+
+		//Releases a view returned by mapFile
+		void unmapFile(const uint8_t* view);
+	}
+}
@@ -0,0 +1,253 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <Eigen/SparseCore>
+#include <Eigen/OrderingMethods>
+
+//Node renumbering for the stiffness matrix. Works on the node graph (one vertex per 6 dof block), so it is
+//6 times smaller than the scalar dof graph while giving the same block bandwidth/fill.
+namespace Beams {
+
+	enum class NodeOrdering {
+		None, //order the element end nodes appear in
+		RCM,  //Reverse Cuthill-McKee, small bandwidth/profile
+		AMD   //Approximate minimum degree, small fill-in
+	};
+
+	//Undirected node graph in CSR form. Neighbour lists are sorted, unique and do not contain the node itself.
+	struct NodeGraph {
+		std::vector<size_t> offsets;
+		std::vector<size_t> adjacency;
+
+		size_t size() const {
+			return offsets.empty() ? 0 : offsets.size() - 1;
+		}
+
+		size_t degree(size_t n) const {
+			return offsets[n + 1] - offsets[n];
+		}
+
+		//edges as node pairs, self loops are ignored
+		void build(size_t noNodes, const std::vector<std::pair<size_t, size_t>>& edges) {
+			offsets.assign(noNodes + 1, 0);
+			for (auto& edge : edges) {
+				if (edge.first == edge.second) continue;
+				offsets[edge.first + 1]++;
+				offsets[edge.second + 1]++;
+			}
+			for (size_t i = 0; i < noNodes; i++) offsets[i + 1] += offsets[i];
+
+			adjacency.resize(offsets.back());
+			std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+			for (auto& edge : edges) {
+				if (edge.first == edge.second) continue;
+				adjacency[fill[edge.first]++] = edge.second;
+				adjacency[fill[edge.second]++] = edge.first;
+			}
+
+			size_t write = 0;
+			size_t begin = 0;
+			for (size_t i = 0; i < noNodes; i++) {
+				size_t end = offsets[i + 1];
+				std::sort(adjacency.begin() + begin, adjacency.begin() + end);
+				size_t newBegin = write;
+				for (size_t k = begin; k < end; k++) {
+					if (write == newBegin || adjacency[write - 1] != adjacency[k]) adjacency[write++] = adjacency[k];
+				}
+				offsets[i] = newBegin;
+				begin = end;
+			}
+			offsets[noNodes] = write;
+			adjacency.resize(write);
+		}
+	};
+
+	//Sizes of the node-block matrix under an ordering. Multiply by 6 (bandwidth) or 36 (profile, fill) for scalar dofs.
+	struct OrderingStats {
+		size_t bandwidth = 0; //max |i-j| of connected nodes
+		size_t profile = 0;   //sum over rows of the distance from the first connected node to the diagonal
+		size_t factorNonZeros = 0; //blocks in the strict lower triangle of the Cholesky factor
+		size_t fillIn = 0;    //factorNonZeros minus blocks in the strict lower triangle of the matrix
+	};
+
+	namespace Ordering {
+
+		//inverse[old] = new for order[new] = old
+		static inline std::vector<size_t> invert(const std::vector<size_t>& order) {
+			std::vector<size_t> inverse(order.size());
+			for (size_t i = 0; i < order.size(); i++) inverse[order[i]] = i;
+			return inverse;
+		}
+
+		//Stats of the graph renumbered by order (order[new] = old). Fill comes from the elimination tree row counts.
+		static inline OrderingStats stats(const NodeGraph& graph, const std::vector<size_t>& order) {
+			OrderingStats result;
+			size_t n = graph.size();
+			std::vector<size_t> newPos = invert(order);
+
+			//neighbours in the new numbering, lower part only, sorted
+			std::vector<std::vector<size_t>> lower(n);
+			for (size_t i = 0; i < n; i++) {
+				size_t row = newPos[i];
+				size_t minCol = row;
+				for (size_t k = graph.offsets[i]; k < graph.offsets[i + 1]; k++) {
+					size_t col = newPos[graph.adjacency[k]];
+					result.bandwidth = std::max(result.bandwidth, (col > row) ? col - row : row - col);
+					if (col < row) {
+						lower[row].push_back(col);
+						minCol = std::min(minCol, col);
+					}
+				}
+				result.profile += row - minCol;
+			}
+
+			//elimination tree (Liu) with path compression
+			const size_t none = SIZE_MAX;
+			std::vector<size_t> parent(n, none), ancestor(n, none);
+			for (size_t k = 0; k < n; k++) {
+				for (size_t j : lower[k]) {
+					size_t i = j;
+					while (i != none && i < k) {
+						size_t next = ancestor[i];
+						ancestor[i] = k;
+						if (next == none) {
+							parent[i] = k;
+							break;
+						}
+						i = next;
+					}
+				}
+			}
+
+			//row k of L holds the nodes on the etree paths from its neighbours up to k
+			std::vector<size_t> mark(n, none);
+			size_t lowerNonZeros = 0;
+			for (size_t k = 0; k < n; k++) {
+				mark[k] = k;
+				lowerNonZeros += lower[k].size();
+				for (size_t j : lower[k]) {
+					for (size_t i = j; mark[i] != k; i = parent[i]) {
+						mark[i] = k;
+						result.factorNonZeros++;
+					}
+				}
+			}
+			result.fillIn = result.factorNonZeros - lowerNonZeros;
+			return result;
+		}
+
+		//George-Liu pseudo peripheral node of the component containing start, by repeated BFS
+		static inline size_t pseudoPeripheral(const NodeGraph& graph, size_t start, std::vector<size_t>& level, std::vector<size_t>& queue) {
+			const size_t none = SIZE_MAX;
+			size_t node = start;
+			size_t eccentricity = 0;
+			while (true) {
+				//BFS from node, level is reset for the visited nodes afterwards
+				queue.clear();
+				queue.push_back(node);
+				level[node] = 0;
+				for (size_t q = 0; q < queue.size(); q++) {
+					size_t v = queue[q];
+					for (size_t k = graph.offsets[v]; k < graph.offsets[v + 1]; k++) {
+						size_t w = graph.adjacency[k];
+						if (level[w] == none) {
+							level[w] = level[v] + 1;
+							queue.push_back(w);
+						}
+					}
+				}
+				size_t lastLevel = level[queue.back()];
+				size_t candidate = queue.back();
+				for (size_t q = queue.size(); q-- > 0 && level[queue[q]] == lastLevel;) {
+					if (graph.degree(queue[q]) < graph.degree(candidate)) candidate = queue[q];
+				}
+				for (size_t v : queue) level[v] = none;
+
+				if (lastLevel <= eccentricity) return node;
+				eccentricity = lastLevel;
+				node = candidate;
+			}
+		}
+
+		//Reverse Cuthill-McKee, component by component
+		static inline std::vector<size_t> reverseCuthillMcKee(const NodeGraph& graph) {
+			const size_t none = SIZE_MAX;
+			size_t n = graph.size();
+			std::vector<size_t> order;
+			order.reserve(n);
+			std::vector<bool> visited(n, false);
+			std::vector<size_t> level(n, none), queue;
+			std::vector<size_t> byDegree(n);
+			std::iota(byDegree.begin(), byDegree.end(), 0);
+			std::stable_sort(byDegree.begin(), byDegree.end(), [&](size_t a, size_t b) {return graph.degree(a) < graph.degree(b); });
+
+			std::vector<size_t> neighbours;
+			for (size_t seed : byDegree) {
+				if (visited[seed]) continue;
+				size_t start = pseudoPeripheral(graph, seed, level, queue);
+
+				size_t head = order.size();
+				order.push_back(start);
+				visited[start] = true;
+				for (; head < order.size(); head++) {
+					size_t v = order[head];
+					neighbours.clear();
+					for (size_t k = graph.offsets[v]; k < graph.offsets[v + 1]; k++) {
+						if (!visited[graph.adjacency[k]]) neighbours.push_back(graph.adjacency[k]);
+					}
+					std::stable_sort(neighbours.begin(), neighbours.end(), [&](size_t a, size_t b) {return graph.degree(a) < graph.degree(b); });
+					for (size_t w : neighbours) {
+						visited[w] = true;
+						order.push_back(w);
+					}
+				}
+			}
+
+			std::reverse(order.begin(), order.end());
+			return order;
+		}
+
+		//Eigen's approximate minimum degree on the node graph pattern
+		static inline std::vector<size_t> approximateMinimumDegree(const NodeGraph& graph) {
+			size_t n = graph.size();
+			Eigen::SparseMatrix<double, Eigen::ColMajor, int> pattern(n, n);
+			pattern.reserve(graph.adjacency.size() + n);
+			for (size_t col = 0; col < n; col++) {
+				pattern.startVec(col);
+				bool diagonalDone = false;
+				for (size_t k = graph.offsets[col]; k < graph.offsets[col + 1]; k++) {
+					size_t row = graph.adjacency[k];
+					if (!diagonalDone && row > col) {
+						pattern.insertBack(col, col) = 1;
+						diagonalDone = true;
+					}
+					pattern.insertBack(row, col) = 1;
+				}
+				if (!diagonalDone) pattern.insertBack(col, col) = 1;
+			}
+			pattern.finalize();
+
+			Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic, int> perm;
+			Eigen::AMDOrdering<int> amd;
+			amd(pattern, perm);
+
+			//perm.indices()[new] = old, same convention as the solvers' inverse permutation
+			std::vector<size_t> order(n);
+			for (size_t i = 0; i < n; i++) order[i] = perm.indices()[i];
+			return order;
+		}
+
+		static inline std::vector<size_t> compute(const NodeGraph& graph, NodeOrdering method) {
+			switch (method) {
+			case NodeOrdering::RCM: return reverseCuthillMcKee(graph);
+			case NodeOrdering::AMD: return approximateMinimumDegree(graph);
+			default: {
+				std::vector<size_t> order(graph.size());
+				std::iota(order.begin(), order.end(), 0);
+				return order;
+			}
+			}
+		}
+	}
+}
@@ -2,6 +2,17 @@
 #include "VBeams.h" 
 #include <unordered_map>
 #include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <atomic>
+#if defined(_WIN32)
+#include "mappedFile.h"
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 //std::ofstream out(fname, std::ios_base::binary);
 namespace Saving {
@@ -25,11 +36,11 @@ namespace Saving {
 	}
 
 	static inline void readNode(std::ifstream& in, Beams::Model& model) {
-		float x = readVar<double>(in);
-		float y = readVar<double>(in);
-		float z = readVar<double>(in);
+		double x = readVar<double>(in);
+		double y = readVar<double>(in);
+		double z = readVar<double>(in);
 
-		model.addNode(Vector3{ x,y,z });
+		model.addNode(x, y, z);
 	}
 
 
@@ -43,12 +54,12 @@ namespace Saving {
 	}
 
 	static inline void readSection(std::ifstream& in, Beams::Model& model) {
-		float Area = readVar<double>(in);
-		float Modulus = readVar<double>(in);
-		float G = readVar<double>(in);
-		float Ixx = readVar<double>(in);
-		float Iyy = readVar<double>(in);
-		float Izz = readVar<double>(in);
+		double Area = readVar<double>(in);
+		double Modulus = readVar<double>(in);
+		double G = readVar<double>(in);
+		double Ixx = readVar<double>(in);
+		double Iyy = readVar<double>(in);
+		double Izz = readVar<double>(in);
 		model.addSection(Area, Modulus, G, Ixx, Iyy, Izz);
 	}
 
@@ -95,7 +106,8 @@ namespace Saving {
 
 
 
-	void saveModel(Beams::Model& model, std::string fname) {
+	//v1: no header, one field at a time. Only kept to write files for older builds, saveModel writes v2.
+	void saveModelV1(Beams::Model& model, std::string fname) {
 		std::ofstream out(fname, std::ios_base::binary);
 
 		const Beams::NodeContainer& nodes = model.getNodes();
@@ -139,35 +151,1381 @@ namespace Saving {
 		out.close();
 	}
 
-	void loadModel(Beams::Model& model, std::string fname) {
+	//Counts are checked against the bytes left before anything is reserved or read, v1 files have no header to check.
+	//A file that does not fit leaves an empty model.
+	static inline bool loadModelV1(Beams::Model& model, std::ifstream& in) {
 		model.clear();
-		std::ifstream in(fname, std::ios_base::binary);
+		model.beginBatch();
+
+		std::streampos start = in.tellg();
+		in.seekg(0, std::ios_base::end);
+		uint64_t fileEnd = (uint64_t)in.tellg();
+		in.seekg(start);
+		auto fits = [&](size_t count, uint64_t itemBytes) {
+			std::streampos position = in.tellg();
+			if (!in || position < 0 || (uint64_t)position > fileEnd || count > (fileEnd - (uint64_t)position) / itemBytes) {
+				model.commit();
+				model.clear();
+				return false;
+			}
+			return true;
+		};
 
 		size_t nodeSize = readVar<size_t>(in);
+		if (!fits(nodeSize, 3 * sizeof(double))) return false;
+		model.reserve(nodeSize, 0);
 		for (size_t i = 0; i < nodeSize; i++) {
 			readNode(in, model);
 		}
 
 		size_t sectionSize = readVar<size_t>(in);
+		if (!fits(sectionSize, 6 * sizeof(double))) return false;
 		for (size_t i = 0; i < sectionSize; i++) {
 			readSection(in, model);
 		}
 
 		size_t elSize = readVar<size_t>(in);
+		if (!fits(elSize, 4 * sizeof(size_t))) return false;
+		model.reserve(0, elSize);
 		for (size_t i = 0; i < elSize; i++) {
 			readElement(in, model);
 		}
 
 		size_t forceSize = readVar<size_t>(in);
+		if (!fits(forceSize, sizeof(size_t) + 6 * sizeof(float))) return false;
 		for (size_t i = 0; i < forceSize; i++) {
 			readForce(in, model);
 		}
 
 		size_t BCSize = readVar<size_t>(in);
+		if (!fits(BCSize, sizeof(size_t))) return false;
 		for (size_t i = 0; i < BCSize; i++) {
 			model.addBCfixed(readVar<size_t>(in));
 		}
+		model.commit();
+		return (bool)in;
+	}
+
+
+	//----------------------------------------------------------------------------------------------------
+	//v2: header, block table and one 64 byte aligned column block per field. Native little endian, 64 bit checksums.
+	//Readers map the file and use the columns in place.
+	//----------------------------------------------------------------------------------------------------
+	namespace V2 {
+		static const char MAGIC[8] = { 'V', 'B', 'E', 'A', 'M', 'v', '2', 0 };
+		static const uint32_t VERSION = 2;
+		static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+		static const uint64_t ALIGNMENT = 64;
+
+		enum class Block : uint32_t {
+			NodeX = 1, NodeY, NodeZ,
+			SectionArea, SectionModulus, SectionG, SectionIxx, SectionIyy, SectionIzz,
+			ElementNode1, ElementNode2, ElementNode3, ElementSection,
+			LoadCaseNames,  //'\0' terminated names, in the order of ForceCase indices
+			ForceCase, ForceNode, ForceValues, //ForceValues: 6 doubles per force
+			BCFixed, BCPinned, BCMaskNode, BCMask,
+			Count
+		};
+
+		struct FileHeader {
+			char magic[8];
+			uint32_t version;
+			uint32_t byteOrder;
+			uint64_t noNodes;
+			uint64_t noSections;
+			uint64_t noElements;
+			uint64_t tableOffset;
+			uint32_t noBlocks;
+			uint32_t reserved;
+			uint64_t tableChecksum;
+			uint64_t headerChecksum; //of the bytes above
+		};
+		static_assert(sizeof(FileHeader) == 72, "FileHeader must not contain padding");
+
+		struct BlockEntry {
+			uint32_t id;
+			uint32_t itemBytes; //size of one entry, 6 * 8 for ForceValues
+			uint64_t offset;
+			uint64_t count;
+			uint64_t checksum;
+		};
+		static_assert(sizeof(BlockEntry) == 32, "BlockEntry must not contain padding");
+
+		static inline uint64_t rotl(uint64_t v, int r) {
+			return (v << r) | (v >> (64 - r));
+		}
+
+		//4 independent multiply/rotate lanes over 8 byte words, so it runs at memory speed
+		static inline uint64_t checksum(const void* data, size_t bytes) {
+			const uint64_t K1 = 0x9E3779B185EBCA87ull, K2 = 0xC2B2AE3D27D4EB4Full;
+			const uint8_t* p = static_cast<const uint8_t*>(data);
+			uint64_t lanes[4] = { K1, K2, ~K1, ~K2 };
+			size_t i = 0;
+			for (; i + 32 <= bytes; i += 32) {
+				for (int l = 0; l < 4; l++) {
+					uint64_t word;
+					std::memcpy(&word, p + i + 8 * l, 8);
+					lanes[l] = rotl(lanes[l] + word * K2, 31) * K1;
+				}
+			}
+			uint64_t h = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18) + bytes;
+			for (; i < bytes; i++) h = rotl(h ^ (p[i] * K1), 11) * K2;
+			return Beams::Duplicates::mix(h);
+		}
+
+		static inline uint64_t alignUp(uint64_t offset) {
+			return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+		}
+
+		struct OutBlock {
+			uint32_t id;
+			uint32_t itemBytes;
+			const void* data;
+			uint64_t count;
+
+			template <typename Id>
+			OutBlock(Id blockId, uint32_t bytesPerItem, const void* items, uint64_t noItems) : id((uint32_t)blockId), itemBytes(bytesPerItem), data(items), count(noItems) {}
+		};
+
+		//Read only view of a whole file. mmap on POSIX, MapViewOfFile on Windows (in mappedFile.cpp, windows.h clashes with raylib's names).
+		class MappedFile {
+			const uint8_t* mapped = nullptr;
+			size_t length = 0;
+
+		public:
+			MappedFile() = default;
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+
+			bool open(const std::string& fname) {
+#if defined(_WIN32)
+				mapped = Windows::mapFile(fname, length);
+				return mapped != nullptr;
+#else
+				int fd = ::open(fname.c_str(), O_RDONLY);
+				if (fd < 0) return false;
+				struct stat info;
+				if (fstat(fd, &info) != 0 || info.st_size == 0) {
+					::close(fd);
+					return false;
+				}
+				length = (size_t)info.st_size;
+				void* view = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+				::close(fd);
+				if (view == MAP_FAILED) return false;
+				madvise(view, length, MADV_SEQUENTIAL);
+				mapped = static_cast<const uint8_t*>(view);
+				return true;
+#endif
+			}
+
+			~MappedFile() {
+#if defined(_WIN32)
+				Windows::unmapFile(mapped);
+#else
+				if (mapped) munmap(const_cast<uint8_t*>(mapped), length);
+#endif
+			}
+
+			const uint8_t* data() const {
+				return mapped;
+			}
+
+			size_t size() const {
+				return length;
+			}
+		};
+
+		//The checked blocks of a mapped file with a block table: v2 model files and results files. Header needs the fields of
+		//FileHeader from magic to byteOrder first and tableOffset, noBlocks, tableChecksum & headerChecksum (last).
+		template <typename Header>
+		class BlockReader {
+			const MappedFile& file;
+			std::vector<const BlockEntry*> table;
+
+		public:
+			Header header;
+			std::string error;
+
+			BlockReader(const MappedFile& mappedFile, uint32_t noIds) : file(mappedFile), table(noIds, nullptr) {}
+
+			bool validate(const char(&magic)[8], uint32_t version, const char* kind) {
+				if (file.size() < sizeof(Header)) return (error = "file too short", false);
+				std::memcpy(&header, file.data(), sizeof(Header));
+				if (std::memcmp(header.magic, magic, sizeof(magic)) != 0) return (error = std::string("not a ") + kind, false);
+				if (header.byteOrder != BYTE_ORDER_MARK) return (error = "written with another byte order", false);
+				if (header.version != version) return (error = "unsupported version " + std::to_string(header.version), false);
+				if (checksum(&header, offsetof(Header, headerChecksum)) != header.headerChecksum) return (error = "header checksum mismatch", false);
+
+				uint64_t tableBytes = (uint64_t)header.noBlocks * sizeof(BlockEntry);
+				if (header.tableOffset % ALIGNMENT || header.tableOffset > file.size() || tableBytes > file.size() - header.tableOffset) return (error = "block table out of range", false);
+				const BlockEntry* entries = reinterpret_cast<const BlockEntry*>(file.data() + header.tableOffset);
+				if (checksum(entries, tableBytes) != header.tableChecksum) return (error = "block table checksum mismatch", false);
+
+				for (uint32_t b = 0; b < header.noBlocks; b++) {
+					const BlockEntry& entry = entries[b];
+					if (entry.id == 0 || entry.id >= table.size()) continue; //blocks of newer writers are skipped
+					if (entry.itemBytes == 0 || entry.offset % ALIGNMENT || entry.offset > file.size() || entry.count > (file.size() - entry.offset) / entry.itemBytes) return (error = "block out of range", false);
+					if (checksum(file.data() + entry.offset, entry.count * entry.itemBytes) != entry.checksum) return (error = "checksum mismatch in block " + std::to_string(entry.id), false);
+					table[entry.id] = &entry;
+				}
+				return true;
+			}
+
+			//Column of a block, nullptr if it is missing or has another item size. count is set to its length.
+			template <typename T, typename Id>
+			const T* column(Id id, uint64_t& count, uint32_t itemBytes = sizeof(T)) const {
+				const BlockEntry* entry = table[(size_t)id];
+				count = 0;
+				if (!entry || entry->itemBytes != itemBytes) return nullptr;
+				count = entry->count;
+				return reinterpret_cast<const T*>(file.data() + entry->offset);
+			}
+
+			//Column that has to hold exactly expected entries. Empty columns give a valid pointer-less result.
+			template <typename T, typename Id>
+			bool column(Id id, uint64_t expected, const T*& values, uint32_t itemBytes = sizeof(T)) {
+				uint64_t count;
+				values = column<T>(id, count, itemBytes);
+				if (count != expected || (!values && expected)) return (error = "missing or short block " + std::to_string((uint32_t)id), false);
+				return true;
+			}
+		};
+
+		class Reader : public BlockReader<FileHeader> {
+		public:
+			explicit Reader(const MappedFile& mappedFile) : BlockReader<FileHeader>(mappedFile, (uint32_t)Block::Count) {}
+
+			bool validate() {
+				return BlockReader<FileHeader>::validate(MAGIC, VERSION, "v2 model file");
+			}
+		};
+
+		//Header with its block fields filled in, the table and the 64 byte aligned blocks. Header as for BlockReader.
+		template <typename Header>
+		static inline bool writeBlocks(const std::string& fname, Header header, const std::vector<OutBlock>& blocks) {
+			header.byteOrder = BYTE_ORDER_MARK;
+			header.noBlocks = (uint32_t)blocks.size();
+			header.tableOffset = alignUp(sizeof(Header));
+
+			std::vector<BlockEntry> table(blocks.size());
+			uint64_t offset = alignUp(header.tableOffset + table.size() * sizeof(BlockEntry));
+			for (size_t b = 0; b < blocks.size(); b++) {
+				uint64_t bytes = blocks[b].count * blocks[b].itemBytes;
+				table[b] = BlockEntry{ blocks[b].id, blocks[b].itemBytes, offset, blocks[b].count, checksum(blocks[b].data, bytes) };
+				offset = alignUp(offset + bytes);
+			}
+			header.tableChecksum = checksum(table.data(), table.size() * sizeof(BlockEntry));
+			header.headerChecksum = checksum(&header, offsetof(Header, headerChecksum));
+
+			std::ofstream out(fname, std::ios_base::binary);
+			static const char padding[ALIGNMENT] = {};
+			uint64_t written = 0;
+			auto put = [&](const void* data, uint64_t bytes, uint64_t at) {
+				out.write(padding, at - written);
+				out.write(static_cast<const char*>(data), bytes);
+				written = at + bytes;
+			};
+			put(&header, sizeof(Header), 0);
+			put(table.data(), table.size() * sizeof(BlockEntry), header.tableOffset);
+			for (size_t b = 0; b < blocks.size(); b++) put(blocks[b].data, blocks[b].count * blocks[b].itemBytes, table[b].offset);
+			return (bool)out;
+		}
+
+		static inline bool write(const std::string& fname, uint64_t noNodes, uint64_t noSections, uint64_t noElements, const std::vector<OutBlock>& blocks) {
+			FileHeader header{};
+			std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+			header.version = VERSION;
+			header.noNodes = noNodes;
+			header.noSections = noSections;
+			header.noElements = noElements;
+			return writeBlocks(fname, header, blocks);
+		}
+	}
+
+	//The v2 columns of a model. Node and section references are renumbered to their save order (getNodes() order), so
+	//deleted node slots are not stored.
+	struct ModelColumns {
+		std::vector<uint64_t> nodeOrder; //node position -> save index, UINT64_MAX for deleted slots
+		std::vector<double> x, y, z;
+		std::array<std::vector<double>, 6> sectionColumns;
+		std::vector<uint64_t> node1, node2, node3, section;
+		std::string caseNames;
+		std::vector<uint64_t> forceCase, forceNode;
+		std::vector<double> forceValues;
+		std::vector<uint64_t> fixed, pinned, maskNode;
+		std::vector<uint8_t> mask;
+
+		explicit ModelColumns(Beams::Model& model) {
+			const Beams::NodeContainer& nodes = model.getNodes();
+			nodeOrder.assign(nodes.slotCount(), UINT64_MAX);
+			x.reserve(nodes.size());
+			y.reserve(nodes.size());
+			z.reserve(nodes.size());
+			for (auto& node : nodes) {
+				nodeOrder[node.pos] = x.size();
+				x.push_back(node.x);
+				y.push_back(node.y);
+				z.push_back(node.z);
+			}
+
+			std::unordered_map<size_t, uint64_t> sectionOrder;
+			for (auto& sec : model.getSections()) {
+				sectionOrder[sec.first] = sectionOrder.size();
+				const Beams::Section& s = sec.second;
+				const double values[6] = { s.Area, s.Modulus, s.G, s.Ixx, s.Iyy, s.Izz };
+				for (int c = 0; c < 6; c++) sectionColumns[c].push_back(values[c]);
+			}
+
+			const std::vector<Beams::vBeam>& elements = model.getElements();
+			node1.resize(elements.size());
+			node2.resize(elements.size());
+			node3.resize(elements.size());
+			section.resize(elements.size());
+			for (size_t i = 0; i < elements.size(); i++) {
+				node1[i] = nodeOrder[elements[i].node1Pos];
+				node2[i] = nodeOrder[elements[i].node2Pos];
+				node3[i] = nodeOrder[elements[i].node3Pos];
+				section[i] = sectionOrder[elements[i].getSectionId()];
+			}
+
+			//forces and BCs sorted by save index, so a saved and reloaded model gives the same columns (and modelHash)
+			uint64_t caseIndex = 0;
+			for (auto& loadCase : model.getLoadCases()) {
+				caseNames.append(loadCase.first).push_back('\0');
+				std::vector<std::pair<uint64_t, const std::array<double, 6>*>> forces;
+				for (auto& force : loadCase.second) {
+					if (force.first < nodeOrder.size() && nodeOrder[force.first] != UINT64_MAX) forces.emplace_back(nodeOrder[force.first], &force.second);
+				}
+				std::sort(forces.begin(), forces.end());
+				for (auto& force : forces) {
+					forceCase.push_back(caseIndex);
+					forceNode.push_back(force.first);
+					forceValues.insert(forceValues.end(), force.second->begin(), force.second->end());
+				}
+				caseIndex++;
+			}
+
+			for (size_t pos : model.getBCfixed()) fixed.push_back(nodeOrder[pos]);
+			for (size_t pos : model.getBCpinned()) pinned.push_back(nodeOrder[pos]);
+			std::sort(fixed.begin(), fixed.end());
+			std::sort(pinned.begin(), pinned.end());
+			std::vector<std::pair<uint64_t, uint8_t>> masks;
+			for (auto& bc : model.getBCmasks()) masks.emplace_back(nodeOrder[bc.first], bc.second);
+			std::sort(masks.begin(), masks.end());
+			for (auto& bc : masks) {
+				maskNode.push_back(bc.first);
+				mask.push_back(bc.second);
+			}
+		}
 
+		std::vector<V2::OutBlock> blocks() const {
+			using V2::Block;
+			size_t noSections = sectionColumns[0].size();
+			return {
+				{ Block::NodeX, 8, x.data(), x.size() }, { Block::NodeY, 8, y.data(), y.size() }, { Block::NodeZ, 8, z.data(), z.size() },
+				{ Block::SectionArea, 8, sectionColumns[0].data(), noSections }, { Block::SectionModulus, 8, sectionColumns[1].data(), noSections },
+				{ Block::SectionG, 8, sectionColumns[2].data(), noSections }, { Block::SectionIxx, 8, sectionColumns[3].data(), noSections },
+				{ Block::SectionIyy, 8, sectionColumns[4].data(), noSections }, { Block::SectionIzz, 8, sectionColumns[5].data(), noSections },
+				{ Block::ElementNode1, 8, node1.data(), node1.size() }, { Block::ElementNode2, 8, node2.data(), node2.size() },
+				{ Block::ElementNode3, 8, node3.data(), node3.size() }, { Block::ElementSection, 8, section.data(), section.size() },
+				{ Block::LoadCaseNames, 1, caseNames.data(), caseNames.size() },
+				{ Block::ForceCase, 8, forceCase.data(), forceCase.size() }, { Block::ForceNode, 8, forceNode.data(), forceNode.size() },
+				{ Block::ForceValues, 6 * 8, forceValues.data(), forceNode.size() },
+				{ Block::BCFixed, 8, fixed.data(), fixed.size() }, { Block::BCPinned, 8, pinned.data(), pinned.size() },
+				{ Block::BCMaskNode, 8, maskNode.data(), maskNode.size() }, { Block::BCMask, 1, mask.data(), mask.size() }
+			};
+		}
+	};
+
+	bool saveModel(Beams::Model& model, std::string fname) {
+		ModelColumns columns(model);
+		return V2::write(fname, columns.x.size(), columns.sectionColumns[0].size(), columns.node1.size(), columns.blocks());
+	}
+
+	//Hash of everything saveModel stores: geometry, sections, BCs and all load cases. Results are tagged with it.
+	uint64_t modelHash(Beams::Model& model) {
+		ModelColumns columns(model);
+		std::vector<uint64_t> blockHashes;
+		for (const V2::OutBlock& block : columns.blocks()) {
+			blockHashes.push_back(block.id);
+			blockHashes.push_back(block.count);
+			blockHashes.push_back(V2::checksum(block.data, block.count * block.itemBytes));
+		}
+		return V2::checksum(blockHashes.data(), blockHashes.size() * 8);
 	}
 
-}
\ No newline at end of file
+	static inline bool loadModelV2(Beams::Model& model, const V2::MappedFile& file) {
+		using V2::Block;
+		V2::Reader reader(file);
+		if (!reader.validate()) {
+			std::cout << "Model file rejected: " << reader.error << "\n";
+			return false;
+		}
+		const V2::FileHeader& header = reader.header;
+		uint64_t noNodes = header.noNodes, noSections = header.noSections, noElements = header.noElements;
+
+		const double *x, *y, *z;
+		const double* sectionColumns[6];
+		const uint64_t *node1, *node2, *node3, *section;
+		bool ok = reader.column(Block::NodeX, noNodes, x) && reader.column(Block::NodeY, noNodes, y) && reader.column(Block::NodeZ, noNodes, z);
+		const Block sectionBlocks[6] = { Block::SectionArea, Block::SectionModulus, Block::SectionG, Block::SectionIxx, Block::SectionIyy, Block::SectionIzz };
+		for (int c = 0; c < 6 && ok; c++) ok = reader.column(sectionBlocks[c], noSections, sectionColumns[c]);
+		ok = ok && reader.column(Block::ElementNode1, noElements, node1) && reader.column(Block::ElementNode2, noElements, node2)
+			&& reader.column(Block::ElementNode3, noElements, node3) && reader.column(Block::ElementSection, noElements, section);
+
+		uint64_t noForces, noCaseNameBytes, noFixed, noPinned, noMasks;
+		const char* caseNames = reader.column<char>(Block::LoadCaseNames, noCaseNameBytes);
+		const uint64_t* forceNode = reader.column<uint64_t>(Block::ForceNode, noForces);
+		const uint64_t* forceCase;
+		const double* forceValues;
+		ok = ok && reader.column(Block::ForceCase, noForces, forceCase) && reader.column(Block::ForceValues, noForces, forceValues, 6 * 8);
+		const uint64_t* fixed = reader.column<uint64_t>(Block::BCFixed, noFixed);
+		const uint64_t* pinned = reader.column<uint64_t>(Block::BCPinned, noPinned);
+		const uint64_t* maskNode = reader.column<uint64_t>(Block::BCMaskNode, noMasks);
+		const uint8_t* mask;
+		ok = ok && reader.column(Block::BCMask, noMasks, mask);
+		if (!ok) {
+			std::cout << "Model file rejected: " << reader.error << "\n";
+			return false;
+		}
+
+		//references are checked before anything is added, a bad file leaves the model untouched
+		std::vector<std::string> cases;
+		for (uint64_t i = 0; i < noCaseNameBytes;) {
+			const char* name = caseNames + i;
+			size_t length = strnlen(name, noCaseNameBytes - i);
+			cases.emplace_back(name, length);
+			i += length + 1;
+		}
+		unsigned noThreads = model.getAssemblyThreads();
+		auto below = [&](const uint64_t* refs, uint64_t count, uint64_t limit) {
+			std::atomic<bool> valid(true);
+			Beams::parallelFor(count, noThreads, [&](size_t begin, size_t end) {
+				for (size_t i = begin; i < end && valid.load(std::memory_order_relaxed); i++) {
+					if (refs[i] >= limit) valid = false;
+				}
+			});
+			return (bool)valid;
+		};
+		bool valid = below(node1, noElements, noNodes) && below(node2, noElements, noNodes) && below(node3, noElements, noNodes)
+			&& below(section, noElements, noSections) && below(forceNode, noForces, noNodes) && below(forceCase, noForces, cases.size())
+			&& below(fixed, noFixed, noNodes) && below(pinned, noPinned, noNodes) && below(maskNode, noMasks, noNodes);
+		if (!valid) {
+			std::cout << "Model file rejected: node, section or load case reference out of range\n";
+			return false;
+		}
+
+		//columns go to the model in one call each: nodes and elements are filled on the assembly threads
+		model.clear();
+		model.beginBatch();
+		model.addNodes(noNodes, x, y, z);
+		for (uint64_t i = 0; i < noSections; i++) {
+			model.addSection(sectionColumns[0][i], sectionColumns[1][i], sectionColumns[2][i], sectionColumns[3][i], sectionColumns[4][i], sectionColumns[5][i]);
+		}
+		model.addElements(noElements, node1, node2, node3, section);
+
+		for (uint64_t i = 0; i < noForces; i++) {
+			model.setActiveLoadCase(cases[forceCase[i]]);
+			for (int d = 0; d < 6; d++) model.addForce(forceNode[i], d, forceValues[6 * i + d]);
+		}
+		for (const std::string& name : cases) model.setActiveLoadCase(name); //cases without forces
+		model.setActiveLoadCase(Beams::DEFAULT_LOADCASE);
+
+		for (uint64_t i = 0; i < noFixed; i++) model.addBCfixed(fixed[i]);
+		for (uint64_t i = 0; i < noPinned; i++) model.addBCpinned(pinned[i]);
+		for (uint64_t i = 0; i < noMasks; i++) model.addBCmask(maskNode[i], mask[i]);
+		model.commit();
+		return true;
+	}
+
+	//----------------------------------------------------------------------------------------------------
+	//Stream: a header followed by self contained chunks of at most chunkSize items, for files that are written or read a
+	//chunk at a time (archives, models larger than RAM). Indices are delta + varint coded, floats optionally XOR packed
+	//(lossless). Every chunk has its own checksum, the End chunk holds the totals.
+	//----------------------------------------------------------------------------------------------------
+	namespace Stream {
+		static const char MAGIC[8] = { 'V', 'B', 'E', 'A', 'M', 's', '1', 0 };
+		static const uint32_t VERSION = 2; //2: chunk checksums cover the chunk header, End holds the support totals
+		static const uint32_t FLOAT_PACKING = 1;
+
+		enum class ChunkKind : uint32_t {
+			Sections = 1, LoadCases, Nodes, Elements, Forces, BCFixed, BCPinned, BCMasks, End
+		};
+
+		struct StreamHeader {
+			char magic[8];
+			uint32_t version;
+			uint32_t byteOrder;
+			uint32_t flags;
+			uint32_t chunkSize;
+			uint64_t checksum; //of the bytes above
+		};
+		static_assert(sizeof(StreamHeader) == 32, "StreamHeader must not contain padding");
+
+		struct ChunkHeader {
+			uint32_t kind;
+			uint32_t count;
+			uint64_t bytes;
+			uint64_t checksum; //of the fields above and the payload
+		};
+		static_assert(sizeof(ChunkHeader) == 24, "ChunkHeader must not contain padding");
+
+		//A chunk with a changed kind or count would otherwise pass as long as its payload is intact
+		static inline uint64_t chunkChecksum(const ChunkHeader& header, const uint8_t* payload) {
+			uint64_t parts[2] = { V2::checksum(&header, offsetof(ChunkHeader, checksum)), V2::checksum(payload, header.bytes) };
+			return V2::checksum(parts, sizeof(parts));
+		}
+
+		struct Options {
+			uint32_t chunkSize = 1 << 16;
+			bool packFloats = true;
+		};
+
+		//Bytes for reading, items for writing
+		struct Progress {
+			uint64_t done = 0;
+			uint64_t total = 0;
+
+			double fraction() const {
+				return total ? (double)done / total : 1.;
+			}
+		};
+
+		class ByteWriter {
+		public:
+			std::vector<uint8_t> bytes;
+
+			void putByte(uint8_t b) {
+				bytes.push_back(b);
+			}
+
+			void putVarint(uint64_t v) {
+				while (v >= 0x80) {
+					bytes.push_back((uint8_t)(v | 0x80));
+					v >>= 7;
+				}
+				bytes.push_back((uint8_t)v);
+			}
+
+			//zigzag, so small negative deltas stay short
+			void putSigned(int64_t v) {
+				putVarint(((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+			}
+
+			void putDelta(uint64_t value, uint64_t& previous) {
+				putSigned((int64_t)(value - previous));
+				previous = value;
+			}
+		};
+
+		//Bounds checked, ok turns false on the first overrun or malformed value and stays false
+		class ByteReader {
+			const uint8_t* p;
+			const uint8_t* end;
+
+		public:
+			bool ok = true;
+
+			ByteReader(const uint8_t* data, size_t bytes) : p(data), end(data + bytes) {}
+
+			size_t remaining() const {
+				return end - p;
+			}
+
+			uint8_t getByte() {
+				if (p == end) {
+					ok = false;
+					return 0;
+				}
+				return *p++;
+			}
+
+			uint64_t getVarint() {
+				uint64_t v = 0;
+				for (int shift = 0; shift < 64; shift += 7) {
+					uint8_t b = getByte();
+					v |= (uint64_t)(b & 0x7F) << shift;
+					if (!(b & 0x80)) return v;
+				}
+				ok = false;
+				return 0;
+			}
+
+			int64_t getSigned() {
+				uint64_t v = getVarint();
+				return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+			}
+
+			uint64_t getDelta(uint64_t& previous) {
+				previous += (uint64_t)getSigned();
+				return previous;
+			}
+		};
+
+		//One column of doubles. Packed: XOR with the previous value of the column, then a byte with the number of leading and
+		//trailing zero bytes (0 if equal) and only the bytes in between. Repeated and grid values shrink to 1 to 3 bytes.
+		class FloatColumn {
+			bool packed;
+			uint64_t previous = 0;
+
+		public:
+			explicit FloatColumn(bool packFloats) : packed(packFloats) {}
+
+			void put(ByteWriter& out, double value) {
+				uint64_t bits;
+				std::memcpy(&bits, &value, 8);
+				if (!packed) {
+					for (int b = 0; b < 8; b++) out.putByte((uint8_t)(bits >> (8 * b)));
+					return;
+				}
+				uint64_t x = bits ^ previous;
+				previous = bits;
+				if (x == 0) {
+					out.putByte(0);
+					return;
+				}
+				int lead = 0, trail = 0;
+				while (!((x >> (56 - 8 * lead)) & 0xFF)) lead++;
+				while (!((x >> (8 * trail)) & 0xFF)) trail++;
+				out.putByte((uint8_t)(0x80 | lead << 3 | trail));
+				for (int b = trail; b < 8 - lead; b++) out.putByte((uint8_t)(x >> (8 * b)));
+			}
+
+			double get(ByteReader& in) {
+				uint64_t bits = 0;
+				if (!packed) {
+					for (int b = 0; b < 8; b++) bits |= (uint64_t)in.getByte() << (8 * b);
+				}
+				else {
+					uint8_t h = in.getByte();
+					uint64_t x = 0;
+					if (h) {
+						int lead = (h >> 3) & 7, trail = h & 7;
+						if (!(h & 0x80) || lead + trail >= 8) in.ok = false;
+						for (int b = trail; b < 8 - lead && in.ok; b++) x |= (uint64_t)in.getByte() << (8 * b);
+					}
+					bits = x ^ previous;
+					previous = bits;
+				}
+				double value;
+				std::memcpy(&value, &bits, 8);
+				return value;
+			}
+		};
+
+		//Items of one chunk. Only the vectors of its kind are filled, first is the index of its first item among all items of
+		//that kind. Vectors keep their capacity between chunks, so reading uses the memory of one chunk.
+		struct Chunk {
+			ChunkKind kind;
+			uint64_t first = 0;
+			size_t count = 0;
+			std::vector<std::array<double, 6>> sections; //Area, Modulus, G, Ixx, Iyy, Izz
+			std::vector<std::string> caseNames;
+			std::vector<double> x, y, z;
+			std::vector<uint64_t> node1, node2, node3, section;
+			std::vector<uint64_t> forceCase;
+			std::vector<std::array<double, 6>> forceValues;
+			std::vector<uint64_t> nodes; //force and BC nodes
+			std::vector<uint8_t> masks;
+		};
+
+		//Items are buffered per kind and written as a chunk once chunkSize of them are collected. Chunks that reference nodes,
+		//sections or load cases flush those first, so a reader always sees what it references. Items are numbered per kind in
+		//the order they are added.
+		class Writer {
+			std::ofstream out;
+			std::string fname;
+			Options options;
+			uint64_t bytesWritten = 0;
+			uint64_t noSections = 0, noCases = 0, noNodes = 0, noElements = 0, noForces = 0;
+			uint64_t noFixed = 0, noPinned = 0, noMasks = 0;
+			ByteWriter payload;
+
+			std::vector<std::array<double, 6>> sections;
+			std::vector<std::string> caseNames;
+			std::vector<double> x, y, z;
+			std::vector<uint64_t> node1, node2, node3, section;
+			std::vector<uint64_t> forceCase, forceNode;
+			std::vector<std::array<double, 6>> forceValues;
+			std::vector<uint64_t> fixed, pinned, maskNode;
+			std::vector<uint8_t> mask;
+
+			void writeChunk(ChunkKind kind, size_t count) {
+				ChunkHeader header{ (uint32_t)kind, (uint32_t)count, payload.bytes.size(), 0 };
+				header.checksum = chunkChecksum(header, payload.bytes.data());
+				out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+				out.write(reinterpret_cast<const char*>(payload.bytes.data()), payload.bytes.size());
+				bytesWritten += sizeof(header) + payload.bytes.size();
+				payload.bytes.clear();
+			}
+
+			void flushSections() {
+				if (sections.empty()) return;
+				FloatColumn column(false);
+				for (auto& sec : sections) {
+					for (double value : sec) column.put(payload, value);
+				}
+				writeChunk(ChunkKind::Sections, sections.size());
+				sections.clear();
+			}
+
+			void flushLoadCases() {
+				if (caseNames.empty()) return;
+				for (auto& name : caseNames) {
+					payload.putVarint(name.size());
+					payload.bytes.insert(payload.bytes.end(), name.begin(), name.end());
+				}
+				writeChunk(ChunkKind::LoadCases, caseNames.size());
+				caseNames.clear();
+			}
+
+			void flushNodes() {
+				if (x.empty()) return;
+				for (const std::vector<double>* coordinates : { &x, &y, &z }) {
+					FloatColumn column(options.packFloats);
+					for (double value : *coordinates) column.put(payload, value);
+				}
+				writeChunk(ChunkKind::Nodes, x.size());
+				x.clear();
+				y.clear();
+				z.clear();
+			}
+
+			//node1 and node3 against the previous element, node2 against node1: connected meshes give 1 to 2 byte deltas
+			void flushElements() {
+				if (node1.empty()) return;
+				flushSections();
+				flushNodes();
+				uint64_t previous1 = 0, previous3 = 0, previousSection = 0;
+				for (size_t i = 0; i < node1.size(); i++) {
+					payload.putDelta(node1[i], previous1);
+					payload.putSigned((int64_t)(node2[i] - node1[i]));
+					payload.putDelta(node3[i], previous3);
+					payload.putDelta(section[i], previousSection);
+				}
+				writeChunk(ChunkKind::Elements, node1.size());
+				node1.clear();
+				node2.clear();
+				node3.clear();
+				section.clear();
+			}
+
+			void flushForces() {
+				if (forceNode.empty()) return;
+				flushLoadCases();
+				flushNodes();
+				uint64_t previousNode = 0;
+				std::vector<FloatColumn> columns(6, FloatColumn(options.packFloats));
+				for (size_t i = 0; i < forceNode.size(); i++) {
+					payload.putVarint(forceCase[i]);
+					payload.putDelta(forceNode[i], previousNode);
+					for (int d = 0; d < 6; d++) columns[d].put(payload, forceValues[i][d]);
+				}
+				writeChunk(ChunkKind::Forces, forceNode.size());
+				forceCase.clear();
+				forceNode.clear();
+				forceValues.clear();
+			}
+
+			void flushBCs(ChunkKind kind, std::vector<uint64_t>& bcNodes) {
+				if (bcNodes.empty()) return;
+				flushNodes();
+				uint64_t previousNode = 0;
+				for (size_t i = 0; i < bcNodes.size(); i++) {
+					payload.putDelta(bcNodes[i], previousNode);
+					if (kind == ChunkKind::BCMasks) payload.putByte(mask[i]);
+				}
+				writeChunk(kind, bcNodes.size());
+				bcNodes.clear();
+				if (kind == ChunkKind::BCMasks) mask.clear();
+			}
+
+			void flushAll() {
+				flushSections();
+				flushLoadCases();
+				flushNodes();
+				flushElements();
+				flushForces();
+				flushBCs(ChunkKind::BCFixed, fixed);
+				flushBCs(ChunkKind::BCPinned, pinned);
+				flushBCs(ChunkKind::BCMasks, maskNode);
+			}
+
+		public:
+			bool open(const std::string& fileName, Options fileOptions = Options()) {
+				fname = fileName;
+				options = fileOptions;
+				options.chunkSize = std::max(options.chunkSize, 1u);
+				out.open(fname, std::ios_base::binary);
+				StreamHeader header{};
+				std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+				header.version = VERSION;
+				header.byteOrder = V2::BYTE_ORDER_MARK;
+				header.flags = options.packFloats ? FLOAT_PACKING : 0;
+				header.chunkSize = options.chunkSize;
+				header.checksum = V2::checksum(&header, offsetof(StreamHeader, checksum));
+				out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+				bytesWritten = sizeof(header);
+				return (bool)out;
+			}
+
+			uint64_t addSection(double Area, double Modulus, double G, double Ixx, double Iyy, double Izz) {
+				sections.push_back({ Area, Modulus, G, Ixx, Iyy, Izz });
+				if (sections.size() == options.chunkSize) flushSections();
+				return noSections++;
+			}
+
+			uint64_t addLoadCase(const std::string& name) {
+				caseNames.push_back(name);
+				if (caseNames.size() == options.chunkSize) flushLoadCases();
+				return noCases++;
+			}
+
+			uint64_t addNode(double nodeX, double nodeY, double nodeZ) {
+				x.push_back(nodeX);
+				y.push_back(nodeY);
+				z.push_back(nodeZ);
+				if (x.size() == options.chunkSize) flushNodes();
+				return noNodes++;
+			}
+
+			uint64_t addElement(uint64_t n1, uint64_t n2, uint64_t n3, uint64_t sectionIndex) {
+				node1.push_back(n1);
+				node2.push_back(n2);
+				node3.push_back(n3);
+				section.push_back(sectionIndex);
+				if (node1.size() == options.chunkSize) flushElements();
+				return noElements++;
+			}
+
+			void addForce(uint64_t caseIndex, uint64_t node, const std::array<double, 6>& values) {
+				forceCase.push_back(caseIndex);
+				forceNode.push_back(node);
+				forceValues.push_back(values);
+				noForces++;
+				if (forceNode.size() == options.chunkSize) flushForces();
+			}
+
+			void addBCfixed(uint64_t node) {
+				fixed.push_back(node);
+				noFixed++;
+				if (fixed.size() == options.chunkSize) flushBCs(ChunkKind::BCFixed, fixed);
+			}
+
+			void addBCpinned(uint64_t node) {
+				pinned.push_back(node);
+				noPinned++;
+				if (pinned.size() == options.chunkSize) flushBCs(ChunkKind::BCPinned, pinned);
+			}
+
+			void addBCmask(uint64_t node, uint8_t bcMask) {
+				maskNode.push_back(node);
+				mask.push_back(bcMask);
+				noMasks++;
+				if (maskNode.size() == options.chunkSize) flushBCs(ChunkKind::BCMasks, maskNode);
+			}
+
+			uint64_t bytes() const {
+				return bytesWritten;
+			}
+
+			//Writes the buffered items and the End chunk
+			bool close() {
+				flushAll();
+				for (uint64_t total : { noSections, noCases, noNodes, noElements, noForces, noFixed, noPinned, noMasks }) payload.putVarint(total);
+				writeChunk(ChunkKind::End, 0);
+				out.close();
+				return !out.fail();
+			}
+
+			//Drops the unfinished file
+			void abort() {
+				out.close();
+				std::remove(fname.c_str());
+			}
+		};
+
+		//Chunks in file order. Every reference is checked against the items read so far, so a chunk can be used as soon as
+		//next returns it.
+		class Reader {
+			std::ifstream in;
+			StreamHeader header;
+			uint64_t fileBytes = 0, position = 0;
+			uint64_t noSections = 0, noCases = 0, noNodes = 0, noElements = 0, noForces = 0;
+			uint64_t noFixed = 0, noPinned = 0, noMasks = 0;
+			bool ended = false;
+			std::vector<uint8_t> payload;
+
+			bool fail(const std::string& message) {
+				error = message;
+				std::cout << "Model file rejected: " << error << "\n";
+				return false;
+			}
+
+			bool decode(ChunkKind kind, size_t count, Chunk& chunk) {
+				ByteReader bytes(payload.data(), payload.size());
+				if (count > payload.size()) return fail("chunk item count larger than its data"); //every item takes at least a byte
+				bool packed = (header.flags & FLOAT_PACKING) != 0;
+				chunk.kind = kind;
+				chunk.count = count;
+				switch (kind) {
+				case ChunkKind::Sections: {
+					chunk.first = noSections;
+					chunk.sections.resize(count);
+					FloatColumn column(false);
+					for (auto& sec : chunk.sections) {
+						for (double& value : sec) value = column.get(bytes);
+					}
+					noSections += count;
+					break;
+				}
+				case ChunkKind::LoadCases:
+					chunk.first = noCases;
+					chunk.caseNames.resize(count);
+					for (auto& name : chunk.caseNames) {
+						uint64_t length = bytes.getVarint();
+						if (!bytes.ok || length > bytes.remaining()) return fail("load case name out of range");
+						name.resize(length);
+						for (char& c : name) c = (char)bytes.getByte();
+					}
+					noCases += count;
+					break;
+				case ChunkKind::Nodes:
+					chunk.first = noNodes;
+					for (std::vector<double>* coordinates : { &chunk.x, &chunk.y, &chunk.z }) {
+						FloatColumn column(packed);
+						coordinates->resize(count);
+						for (double& value : *coordinates) value = column.get(bytes);
+					}
+					noNodes += count;
+					break;
+				case ChunkKind::Elements: {
+					chunk.first = noElements;
+					chunk.node1.resize(count);
+					chunk.node2.resize(count);
+					chunk.node3.resize(count);
+					chunk.section.resize(count);
+					uint64_t previous1 = 0, previous3 = 0, previousSection = 0;
+					for (size_t i = 0; i < count; i++) {
+						chunk.node1[i] = bytes.getDelta(previous1);
+						chunk.node2[i] = chunk.node1[i] + (uint64_t)bytes.getSigned();
+						chunk.node3[i] = bytes.getDelta(previous3);
+						chunk.section[i] = bytes.getDelta(previousSection);
+						if (chunk.node1[i] >= noNodes || chunk.node2[i] >= noNodes || chunk.node3[i] >= noNodes || chunk.section[i] >= noSections) {
+							return fail("element references a node or section that was not read before it");
+						}
+					}
+					noElements += count;
+					break;
+				}
+				case ChunkKind::Forces: {
+					chunk.first = noForces;
+					chunk.forceCase.resize(count);
+					chunk.nodes.resize(count);
+					chunk.forceValues.resize(count);
+					uint64_t previousNode = 0;
+					std::vector<FloatColumn> columns(6, FloatColumn(packed));
+					for (size_t i = 0; i < count; i++) {
+						chunk.forceCase[i] = bytes.getVarint();
+						chunk.nodes[i] = bytes.getDelta(previousNode);
+						for (int d = 0; d < 6; d++) chunk.forceValues[i][d] = columns[d].get(bytes);
+						if (chunk.forceCase[i] >= noCases || chunk.nodes[i] >= noNodes) return fail("force references a node or load case that was not read before it");
+					}
+					noForces += count;
+					break;
+				}
+				case ChunkKind::BCFixed:
+				case ChunkKind::BCPinned:
+				case ChunkKind::BCMasks: {
+					chunk.first = 0;
+					chunk.nodes.resize(count);
+					chunk.masks.resize(kind == ChunkKind::BCMasks ? count : 0);
+					uint64_t previousNode = 0;
+					for (size_t i = 0; i < count; i++) {
+						chunk.nodes[i] = bytes.getDelta(previousNode);
+						if (kind == ChunkKind::BCMasks) chunk.masks[i] = bytes.getByte();
+						if (chunk.nodes[i] >= noNodes) return fail("support references a node that was not read before it");
+					}
+					(kind == ChunkKind::BCFixed ? noFixed : kind == ChunkKind::BCPinned ? noPinned : noMasks) += count;
+					break;
+				}
+				case ChunkKind::End: {
+					uint64_t totals[8];
+					for (uint64_t& total : totals) total = bytes.getVarint();
+					if (totals[0] != noSections || totals[1] != noCases || totals[2] != noNodes || totals[3] != noElements || totals[4] != noForces
+						|| totals[5] != noFixed || totals[6] != noPinned || totals[7] != noMasks) {
+						return fail("item counts do not match the end of the file");
+					}
+					ended = true;
+					break;
+				}
+				default:
+					return true; //chunks of newer writers are skipped
+				}
+				if (!bytes.ok) return fail("malformed chunk");
+				if (bytes.remaining()) return fail("chunk holds more data than its items");
+				return true;
+			}
+
+		public:
+			std::string error;
+
+			bool open(const std::string& fname) {
+				in.open(fname, std::ios_base::binary | std::ios_base::ate);
+				if (!in) return fail("cannot open " + fname);
+				fileBytes = (uint64_t)in.tellg();
+				in.seekg(0);
+				if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))) return fail("file too short");
+				position = sizeof(header);
+				if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) return fail("not a stream model file");
+				if (header.byteOrder != V2::BYTE_ORDER_MARK) return fail("written with another byte order");
+				if (header.version != VERSION) return fail("unsupported version " + std::to_string(header.version));
+				if (V2::checksum(&header, offsetof(StreamHeader, checksum)) != header.checksum) return fail("header checksum mismatch");
+				return true;
+			}
+
+			const StreamHeader& getHeader() const {
+				return header;
+			}
+
+			Progress progress() const {
+				return Progress{ position, fileBytes };
+			}
+
+			//Next chunk into chunk. False after the End chunk, or on an error (error is set then).
+			bool next(Chunk& chunk) {
+				if (ended || !error.empty()) return false;
+				ChunkHeader chunkHeader;
+				if (!in.read(reinterpret_cast<char*>(&chunkHeader), sizeof(chunkHeader))) return fail("file ends before its End chunk");
+				position += sizeof(chunkHeader);
+				if (chunkHeader.bytes > fileBytes - position) return fail("chunk runs past the end of the file");
+				payload.resize(chunkHeader.bytes);
+				if (!in.read(reinterpret_cast<char*>(payload.data()), payload.size())) return fail("file ends inside a chunk");
+				position += chunkHeader.bytes;
+				if (chunkChecksum(chunkHeader, payload.data()) != chunkHeader.checksum) return fail("chunk checksum mismatch");
+				return decode((ChunkKind)chunkHeader.kind, chunkHeader.count, chunk) && !ended;
+			}
+		};
+
+		//Calls onChunk(const Chunk&, const Progress&) for every chunk, it returns false to cancel.
+		//Returns true only if the whole file was read.
+		template <typename OnChunk>
+		bool read(const std::string& fname, OnChunk onChunk) {
+			Reader reader;
+			if (!reader.open(fname)) return false;
+			Chunk chunk;
+			while (reader.next(chunk)) {
+				if (!onChunk(chunk, reader.progress())) return false;
+			}
+			return reader.error.empty();
+		}
+	}
+
+	//Writes the model as a stream file. onProgress(const Stream::Progress&) is called after every chunkSize items and
+	//returns false to cancel, which removes the unfinished file.
+	template <typename OnProgress>
+	bool saveModelStream(Beams::Model& model, std::string fname, Stream::Options options, OnProgress onProgress) {
+		const Beams::NodeContainer& nodes = model.getNodes();
+		const std::vector<Beams::vBeam>& elements = model.getElements();
+		const std::map<size_t, Beams::Section>& sections = model.getSections();
+		uint64_t noForces = 0;
+		for (auto& loadCase : model.getLoadCases()) noForces += loadCase.second.size();
+		Stream::Progress progress{ 0, sections.size() + nodes.size() + elements.size() + noForces };
+
+		Stream::Writer writer;
+		if (!writer.open(fname, options)) return false;
+		options.chunkSize = std::max(options.chunkSize, 1u);
+		auto itemDone = [&]() {
+			if (++progress.done % options.chunkSize || onProgress(progress)) return true;
+			writer.abort();
+			return false;
+		};
+
+		std::unordered_map<size_t, uint64_t> sectionOrder;
+		for (auto& sec : sections) {
+			const Beams::Section& s = sec.second;
+			sectionOrder[sec.first] = writer.addSection(s.Area, s.Modulus, s.G, s.Ixx, s.Iyy, s.Izz);
+			if (!itemDone()) return false;
+		}
+		std::vector<uint64_t> nodeOrder(nodes.slotCount(), UINT64_MAX);
+		for (auto& node : nodes) {
+			nodeOrder[node.pos] = writer.addNode(node.x, node.y, node.z);
+			if (!itemDone()) return false;
+		}
+		for (auto& element : elements) {
+			writer.addElement(nodeOrder[element.node1Pos], nodeOrder[element.node2Pos], nodeOrder[element.node3Pos], sectionOrder[element.getSectionId()]);
+			if (!itemDone()) return false;
+		}
+		for (auto& loadCase : model.getLoadCases()) {
+			uint64_t caseIndex = writer.addLoadCase(loadCase.first);
+			for (auto& force : loadCase.second) {
+				if (force.first < nodeOrder.size() && nodeOrder[force.first] != UINT64_MAX) writer.addForce(caseIndex, nodeOrder[force.first], force.second);
+				if (!itemDone()) return false;
+			}
+		}
+		for (size_t pos : model.getBCfixed()) writer.addBCfixed(nodeOrder[pos]);
+		for (size_t pos : model.getBCpinned()) writer.addBCpinned(nodeOrder[pos]);
+		for (auto& bc : model.getBCmasks()) writer.addBCmask(nodeOrder[bc.first], bc.second);
+
+		bool ok = writer.close();
+		progress.done = progress.total;
+		onProgress(progress);
+		return ok;
+	}
+
+	bool saveModelStream(Beams::Model& model, std::string fname, Stream::Options options = Stream::Options()) {
+		return saveModelStream(model, fname, options, [](const Stream::Progress&) {return true; });
+	}
+
+	//Builds the model a chunk at a time inside one batch. onProgress(const Stream::Progress&) is called after every chunk
+	//and returns false to cancel; a cancelled or rejected load leaves an empty model.
+	template <typename OnProgress>
+	bool loadModelStream(Beams::Model& model, std::string fname, OnProgress onProgress) {
+		model.clear();
+		model.beginBatch();
+		std::vector<std::string> cases;
+		bool complete = Stream::read(fname, [&](const Stream::Chunk& chunk, const Stream::Progress& progress) {
+			switch (chunk.kind) {
+			case Stream::ChunkKind::Sections:
+				for (auto& s : chunk.sections) model.addSection(s[0], s[1], s[2], s[3], s[4], s[5]);
+				break;
+			case Stream::ChunkKind::LoadCases:
+				for (auto& name : chunk.caseNames) {
+					cases.push_back(name);
+					model.setActiveLoadCase(name);
+				}
+				break;
+			case Stream::ChunkKind::Nodes:
+				model.addNodes(chunk.count, chunk.x.data(), chunk.y.data(), chunk.z.data());
+				break;
+			case Stream::ChunkKind::Elements:
+				model.addElements(chunk.count, chunk.node1.data(), chunk.node2.data(), chunk.node3.data(), chunk.section.data());
+				break;
+			case Stream::ChunkKind::Forces:
+				for (size_t i = 0; i < chunk.count; i++) {
+					model.setActiveLoadCase(cases[chunk.forceCase[i]]);
+					for (int d = 0; d < 6; d++) model.addForce(chunk.nodes[i], d, chunk.forceValues[i][d]);
+				}
+				break;
+			case Stream::ChunkKind::BCFixed:
+				for (uint64_t node : chunk.nodes) model.addBCfixed(node);
+				break;
+			case Stream::ChunkKind::BCPinned:
+				for (uint64_t node : chunk.nodes) model.addBCpinned(node);
+				break;
+			case Stream::ChunkKind::BCMasks:
+				for (size_t i = 0; i < chunk.count; i++) model.addBCmask(chunk.nodes[i], chunk.masks[i]);
+				break;
+			default:
+				break;
+			}
+			return onProgress(progress);
+		});
+		model.setActiveLoadCase(Beams::DEFAULT_LOADCASE);
+		model.commit();
+		if (!complete) model.clear();
+		return complete;
+	}
+
+	bool loadModelStream(Beams::Model& model, std::string fname) {
+		return loadModelStream(model, fname, [](const Stream::Progress&) {return true; });
+	}
+
+	//Reads v2, stream and the headerless v1 files. Returns false if the file could not be read, a rejected v2 file leaves the model unchanged.
+	bool loadModel(Beams::Model& model, std::string fname) {
+		char magic[sizeof(V2::MAGIC)] = {};
+		{
+			std::ifstream probe(fname, std::ios_base::binary);
+			if (!probe) return false;
+			probe.read(magic, sizeof(magic));
+		}
+		if (std::memcmp(magic, V2::MAGIC, sizeof(magic)) == 0) {
+			V2::MappedFile file;
+			if (!file.open(fname)) return false;
+			return loadModelV2(model, file);
+		}
+		if (std::memcmp(magic, Stream::MAGIC, sizeof(magic)) == 0) return loadModelStream(model, fname);
+
+		std::ifstream in(fname, std::ios_base::binary);
+		return loadModelV1(model, in);
+	}
+
+	//----------------------------------------------------------------------------------------------------
+	//Results file next to the model file, in the v2 block layout: displacements and support reactions (6 per node, getNodes()
+	//order) and local element end forces (12 per element) of every load case. Tagged with the modelHash of the model they
+	//were solved for, so results of another version of the model are not shown.
+	//----------------------------------------------------------------------------------------------------
+	namespace Results {
+		static const char MAGIC[8] = { 'V', 'B', 'E', 'A', 'M', 'r', '1', 0 };
+		static const uint32_t VERSION = 1;
+
+		enum class Block : uint32_t {
+			CaseNames = 1, //'\0' terminated, in the order of the case columns
+			Displacements, //6 per node per case, one case after the other
+			ReactionNodes, //save index of every supported node, ascending
+			Reactions, //6 per supported node per case
+			EndForces, //12 per element per case
+			Count
+		};
+
+		struct ResultsHeader {
+			char magic[8];
+			uint32_t version;
+			uint32_t byteOrder;
+			uint64_t modelHash;
+			uint64_t noNodes;
+			uint64_t noElements;
+			uint64_t noCases;
+			uint64_t tableOffset;
+			uint32_t noBlocks;
+			uint32_t reserved;
+			uint64_t tableChecksum;
+			uint64_t headerChecksum; //of the bytes above
+		};
+		static_assert(sizeof(ResultsHeader) == 80, "ResultsHeader must not contain padding");
+
+		//Mapped and checked results file, on Windows too. The columns point into the mapping, they are valid as long as the File is.
+		//Do not save results over a file that is open here: Windows refuses the write, on POSIX the columns would change underneath.
+		class File {
+			V2::MappedFile file;
+			V2::BlockReader<ResultsHeader> reader;
+			const double* displacements = nullptr;
+			const double* reactions = nullptr;
+			const double* endForces = nullptr;
+			const uint64_t* reactionNodes = nullptr;
+			uint64_t noReactionNodes = 0;
+
+		public:
+			std::vector<std::string> cases;
+
+			File() : reader(file, (uint32_t)Block::Count) {}
+
+			//False without a message if there is no file
+			bool open(const std::string& fname) {
+				if (!file.open(fname)) return false;
+				bool ok = reader.validate(MAGIC, VERSION, "results file");
+				const ResultsHeader& h = reader.header;
+				uint64_t noNameBytes = 0;
+				const char* names = ok ? reader.column<char>(Block::CaseNames, noNameBytes) : nullptr;
+				for (uint64_t i = 0; i < noNameBytes;) {
+					size_t length = strnlen(names + i, noNameBytes - i);
+					cases.emplace_back(names + i, length);
+					i += length + 1;
+				}
+				reactionNodes = ok ? reader.column<uint64_t>(Block::ReactionNodes, noReactionNodes) : nullptr;
+				ok = ok && cases.size() == h.noCases && reader.column(Block::Displacements, 6 * h.noNodes * h.noCases, displacements)
+					&& reader.column(Block::Reactions, 6 * noReactionNodes * h.noCases, reactions) && reader.column(Block::EndForces, 12 * h.noElements * h.noCases, endForces);
+				if (!ok) {
+					std::cout << "Results file rejected: " << (reader.error.empty() ? "load cases do not match" : reader.error) << "\n";
+					cases.clear();
+				}
+				return ok;
+			}
+
+			const ResultsHeader& header() const {
+				return reader.header;
+			}
+
+			//6 per node of case c
+			const double* getDisplacements(size_t c) const {
+				return displacements + 6 * reader.header.noNodes * c;
+			}
+
+			uint64_t getNoReactionNodes() const {
+				return noReactionNodes;
+			}
+
+			const uint64_t* getReactionNodes() const {
+				return reactionNodes;
+			}
+
+			//6 per reaction node of case c
+			const double* getReactions(size_t c) const {
+				return reactions + 6 * noReactionNodes * c;
+			}
+
+			//12 per element of case c
+			const double* getEndForces(size_t c) const {
+				return endForces + 12 * reader.header.noElements * c;
+			}
+		};
+	}
+
+	//model.vbeam -> model.vbres
+	std::string resultsFileName(const std::string& modelFileName) {
+		const std::string extension = ".vbeam";
+		if (modelFileName.size() >= extension.size() && modelFileName.compare(modelFileName.size() - extension.size(), extension.size(), extension) == 0) {
+			return modelFileName.substr(0, modelFileName.size() - extension.size()) + ".vbres";
+		}
+		return modelFileName + ".vbres";
+	}
+
+	//Results of all load cases of a solved model. False if it is not solved or a load case was added since.
+	bool saveResults(Beams::Model& model, std::string fname) {
+		const std::vector<std::string>& cases = model.getSolvedCases();
+		if (!model.isSolved() || cases.size() != model.getLoadCases().size()) return false;
+
+		const Beams::NodeContainer& nodes = model.getNodes();
+		std::vector<uint64_t> reactionNodes;
+		std::vector<const Beams::Node*> supported;
+		std::set<size_t> supports(model.getBCfixed());
+		supports.insert(model.getBCpinned().begin(), model.getBCpinned().end());
+		for (auto& bc : model.getBCmasks()) supports.insert(bc.first);
+		uint64_t saveIndex = 0;
+		for (auto& node : nodes) {
+			if (supports.count(node.pos) && !node.free_flag) {
+				reactionNodes.push_back(saveIndex);
+				supported.push_back(&node);
+			}
+			saveIndex++;
+		}
+
+		std::string caseNames;
+		size_t noNodes = nodes.size(), noElements = model.getElements().size();
+		std::vector<double> displacements(6 * noNodes * cases.size(), 0.), reactions, endForces;
+		reactions.reserve(6 * supported.size() * cases.size());
+		endForces.reserve(12 * noElements * cases.size());
+		for (size_t c = 0; c < cases.size(); c++) {
+			caseNames.append(cases[c]).push_back('\0');
+			Eigen::VectorXd u = model.getDisplacements(cases[c]);
+			double* caseDisplacements = displacements.data() + 6 * noNodes * c;
+			for (auto& node : nodes) {
+				if (!node.free_flag) std::copy(u.data() + 6 * node.matrixPos, u.data() + 6 * node.matrixPos + 6, caseDisplacements);
+				caseDisplacements += 6;
+			}
+			Eigen::VectorXd r = model.getReactions(cases[c]);
+			for (const Beams::Node* node : supported) reactions.insert(reactions.end(), r.data() + 6 * node->matrixPos, r.data() + 6 * node->matrixPos + 6);
+			Eigen::MatrixXd f = model.getElementEndForces(cases[c]);
+			endForces.insert(endForces.end(), f.data(), f.data() + f.size());
+		}
+
+		Results::ResultsHeader header{};
+		std::memcpy(header.magic, Results::MAGIC, sizeof(Results::MAGIC));
+		header.version = Results::VERSION;
+		header.modelHash = modelHash(model);
+		header.noNodes = noNodes;
+		header.noElements = noElements;
+		header.noCases = cases.size();
+		using Results::Block;
+		std::vector<V2::OutBlock> blocks = {
+			{ Block::CaseNames, 1, caseNames.data(), caseNames.size() },
+			{ Block::Displacements, 8, displacements.data(), displacements.size() },
+			{ Block::ReactionNodes, 8, reactionNodes.data(), reactionNodes.size() },
+			{ Block::Reactions, 8, reactions.data(), reactions.size() },
+			{ Block::EndForces, 8, endForces.data(), endForces.size() }
+		};
+		return V2::writeBlocks(fname, header, blocks);
+	}
+
+	//Shows the results of a results file without solving, if they were solved for the model as it is now
+	bool loadResults(Beams::Model& model, std::string fname) {
+		Results::File file;
+		if (!file.open(fname)) return false;
+		if (file.header().modelHash != modelHash(model) || file.header().noNodes != model.getNodes().size()) {
+			std::cout << "Results in " << fname << " belong to another version of the model - solve again\n";
+			return false;
+		}
+		return model.setResults(file.cases, [&](size_t c) {return file.getDisplacements(c); });
+	}
+}